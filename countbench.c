@@ -1,7 +1,8 @@
-// cc -g -march=native -std=gnu99 -Wall -Wextra -O3 countbench.c -o countbench
+// cc -g -std=gnu99 -Wall -Wextra -O3 countbench.c histogram.c datagen.c -o countbench -lpthread -lm
 // Source mangled by Nathan Kurz to create a more focussed benchmark than original
 // Optimized for Intel Haswell with gcc compiler.  Works on Sandy Bridge but slower.
-// ICC works but is slower.  Clang requires '-mavx2' flag (or appropriate equivalent)
+// ICC works but is slower.  Kernel variants are picked at run time from the CPU,
+// so one binary covers SSE4.1 through AVX2 machines (--dispatch shows the choice).
 
 /*
   Based on fullbench.c - Demo program to benchmark open-source compression algorithm
@@ -18,23 +19,58 @@
 // #define TIMELOOP   2500
 #define ITERATIONS 10000
 #define NBLOOPS    6
-#define PROBATABLESIZE 2048
 
 #define KB *(1<<10)
 #define MB *(1<<20)
 #define GB *(1<<30)
 
 #define DEFAULT_BLOCKSIZE (64 KB)
+#define DEFAULT_LARGE_BLOCKSIZE (64 MB)  // -T and -L: big enough to leave the caches
+#define DEFAULT_THREADS 1
+#define DEFAULT_STREAM_CHUNK (1 KB)
+#define GUARD_MAXSIZE (2 KB)
+#define VERIFY_MAXSMALL 1024  // --verify: every size up to this, then g_verifySizes
+#define VERIFY_MAXALIGN 64
+#define VERIFY_MAXSMALL16 64  // --verify of the 16-bit kernels: symbol counts up to this
+#define AUTOTUNE_BYTES (8 MB)  // processed per loop, kernel, block size and distribution
+#define AUTOTUNE_LOOPS 3       // best of, per distribution
+#define DEFAULT_TUNING_FILE "histogram.tune"
 #define DEFAULT_PROBA 20
+#define DEFAULT_BLOCKSIZE16 (1 MB)  // 16-bit kernels: tables reach 1 MB, give them room
+#define DEFAULT_BATCH 4
+#define MAX_BATCH 64
+#define BATCH_BLOCKSIZE (4 KB)
+#define FLUSH_BLOCKSIZE (4 KB)  // -L: flush cost measured on blocks this size
+#define FLUSH_CALLS 4096
+#define FLUSH_LOOPS 5
+#define REDUCE_CALLS (1<<12)  // -v: 16-table reductions timed
+#define SWEEP_MINSIZE 256
+#define SWEEP_MAXSIZE (1 GB)
+#define SWEEP_BYTES (64 MB)  // processed per kernel and size, at least one call
+#define MAX_PROBAS 16  // -P list for skew sweeps
+#define MAX_INPUTS 64  // -D distributions (each geometric one times -P)
 
 #include <stdlib.h>    // malloc()
 #include <stdio.h>     // fprintf()
 #include <string.h>    // strcmp()
-#include <sys/timeb.h> // timeb()
+#include <time.h>      // clock_gettime()
+#include <x86intrin.h> // __rdtscp()
 #include <stdint.h>    // int/uintX_t types
-#include <x86intrin.h> // vector intrinsics (depends on -march/-m flag)
-#include <malloc.h>    // memalign()
-#include <ctype.h>     // isspace()
+#include <sys/mman.h>  // mmap(), mprotect(), madvise()
+#include <sys/stat.h>  // fstat()
+#include <fcntl.h>     // open()
+#include <unistd.h>    // sysconf()
+#include <signal.h>    // sigaction()
+#include <setjmp.h>    // sigsetjmp()
+#include <math.h>      // sqrt()
+#include <errno.h>     // errno
+#include <fnmatch.h>   // fnmatch()
+#include <sys/ioctl.h> // ioctl()
+#include <sys/syscall.h>        // SYS_perf_event_open
+#include <linux/perf_event.h>   // perf_event_attr
+
+#include "histogram.h" // kernels being benchmarked
+#include "datagen.h"   // synthetic inputs
 
 typedef uint8_t  BYTE;
 typedef uint16_t U16;
@@ -44,7 +80,7 @@ typedef uint64_t U64;
 
 #ifdef LIKWID
 #include <likwid.h>
-// cc -g -march=native -std=gnu99 -Wall -Wextra -O3 countbench.c -o countbench -DLIKWID -llikwid -lpthread -lm
+// cc -g -march=native -std=gnu99 -Wall -Wextra -O3 countbench.c histogram.c datagen.c -o countbench -DLIKWID -llikwid -lpthread -lm
 // likwid -m -g UOPS_EXECUTED_PORT_PORT_4:PMC0,UOPS_EXECUTED_PORT_PORT_7:PMC1,UOPS_EXECUTED_PORT_PORT_2:PMC2,UOPS_EXECUTED_PORT_PORT_3:PMC3 -C2 countbench -i2   -P90 -b7
 #else
 #define likwid_markerInit()
@@ -54,1452 +90,1356 @@ typedef uint64_t U64;
 #define likwid_markerClose()
 #endif // LIKWID
 
-#ifdef IACA
-// cc -march=native -std=gnu11 -Wall -Wextra -O3 -c countbench.c -DIACA -o iaca.o
-// iaca  -mark 0 -64 -arch HSW -analysis THROUGHPUT iaca.o
-#include </opt/intel/iaca/include/iacaMarks.h>
-#else
-#define IACA_START
-#define IACA_END
-#endif
-
-#ifndef DEBUG
-#define DEBUG_PRINT(format, args...)
-#define DEBUG_ASSERT(test, args...)
-#define DEBUG_ALWAYS(actions...)
-#define DEBUG_IS_ACTIVE 0
-#define DEBUG_ACTIVE(actions...)
-#else // DEBUG
-// cc -g -march=native -std=gnu99 -Wall -Wextra -O3 countbench.c -o countbench -DDEBUG
-// DEBUG=triv* countbench -P90 -b1 | head -2
-
-/* If the program has been compiled with -DDEBUG, debug printing can be 
-   turned on using the environment variable DEBUG.  This can be set from 
-   the command line as 'DEBUG=foo_* program'. 
-
-      func_exact              -> function exactly 'func_exact'
-      func_wild*              -> function starting with 'func_wild'
-      *                       -> all functions
-
-   The wildcard character '*' may only go at the end of an identifier.
-   Multiple conditions should be comma separated: 'DEBUG=func1_*,func2_*'
-   Whitespace before or after a separating comma is allowed and ignored.
-*/
-
-#define COMPILER_POSSIBLY_UNUSED __attribute__((unused))   
-
-#define DEBUG_PRINT_INTERNAL(format, args...)                          \
-    do {                                                               \
-        if (! isspace(*format)) {                                      \
-            fprintf(stderr, "%s:%d %s(): ", __FILE__, __LINE__, __func__);  \
-        }                                                              \
-        fprintf(stderr, format "\n" , ## args);   \
-    } while (0)
-
-// abort on error if test fails
-#define DEBUG_ASSERT(test, args...)                                    \
-    do {                                                               \
-        if (!(test)) {                                                 \
-            DEBUG_PRINT_INTERNAL("ASSERT FAILED (" #test ")\n" args);  \
-            abort();                                                   \
-        }                                                              \
-    } while (0)        
-
-// print according to $ENV{DEBUG} matching function name
-#define DEBUG_PRINT(format, args...)                                   \
-    do {                                                               \
-        if (debug_should_print(__func__)) {                            \
-                DEBUG_PRINT_INTERNAL(format , ## args);                \
-        }                                                              \
-    } while (0)
-
-// shorthand for #if DEBUG { actions } #endif  (always executes on -DDEBUG)
-#define DEBUG_ALWAYS(actions...)  actions
-
-// boolean to determine if $ENV{DEBUG} includes the current fucntions
-#define DEBUG_IS_ACTIVE (debug_should_print(__func__))
-
-#define DEBUG_ACTIVE(actions...) if (DEBUG_IS_ACTIVE) { (actions); } 
-
-// strategy is to allocate nothing so nothing leaks
-COMPILER_POSSIBLY_UNUSED static int debug_should_print(const char *func) {
-    static char *debug_env; // static variable per compilation unit
-    
-    if (! debug_env) { // cache result of getenv()
-        debug_env = getenv("DEBUG");
-        if (! debug_env) debug_env = "";
-    }
-
-    char *test = debug_env;
-    if (*test == '*') return 1; 
-    if (*test == '\0') return 0;
-
-    size_t func_len = strlen(func);
-
-    while (1) {
-        while(isspace(*test)) test++; // skip leading whitespace
-        if (! *test) return 0;        // 'not found' if end of string
-
-        char *next = strchr(test, ',');
-        char *last = next ? next - 1 : test + strlen(test) - 1;
-        while (isspace(*last)) last--; // skip trailing whitespace
-        size_t len = 1 + last - test;
-        
-        if (test[len - 1] == '*') {   // match to wildcard if there is one
-            if (! memcmp(test, func, len - 1)) return 1;
-        } else {                      // otherwise must match whole string
-            if (func_len == len && !memcmp(test, func, len)) return 1;
-        }
-        
-        if (next) test = next + 1;    // skip over comma and check next
-        else return 0;                // 'not found' if no next exists
-    }
-}
-
-#endif // DEBUG
-
 
 #define BMK_DISPLAY(...) fprintf(stderr, __VA_ARGS__)
 
-static U32 BMK_GetMilliStart(void)
+// Wall clock in ns, not slewed by NTP
+static U64 BMK_clockNs(void)
 {
-    struct timeb tb;
-    U32 nCount;
-    ftime( &tb );
-    nCount = (U32) (((tb.time & 0xFFFFF) * 1000) +  tb.millitm);
-    return nCount;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (U64)ts.tv_sec * 1000000000ULL + (U64)ts.tv_nsec;
 }
 
-static U32 BMK_GetMilliSpan(U32 nTimeStart)
+// Time stamp counter, after all earlier instructions have executed.  It
+// ticks at the nominal frequency, so cycles/byte are reference cycles.
+static U64 BMK_cycles(void)
 {
-    U32 nCurrent = BMK_GetMilliStart();
-    U32 nSpan = nCurrent - nTimeStart;
-    if (nTimeStart > nCurrent)
-        nSpan += 0x100000 * 1000;
-    return nSpan;
+    unsigned aux;
+    return __rdtscp(&aux);
 }
 
-#define BMK_PRIME1   2654435761U
-#define BMK_PRIME2   2246822519U
-static U32 BMK_rand (U32* seed)
+// Generated input, kept from one kernel to the next: it is only generated
+// again (outside the timed loops) when the spec, size or symbol width changes
+static struct {
+    void* data;
+    size_t size;
+    DG_spec_t spec;
+    unsigned symbolBits;  // 0 for bytes
+} g_data;
+static double g_inputEntropy = -1;  // bits/byte of what is being timed, < 0 if unknown
+static unsigned g_allocFlags = 0;      // --hugetlb
+static int g_allocNode = HIST_NODE_ANY; // --node
+static unsigned g_touchThreads = 0;    // --numa: first touch by the -T workers
+
+static const void* BMK_getData(const DG_spec_t* spec, size_t size, unsigned symbolBits)
 {
-    *seed =  ( (*seed) * BMK_PRIME1) + BMK_PRIME2;
-    return (*seed) >> 11;
+    char specName[32];
+
+    if (g_data.data && g_data.size == size && g_data.symbolBits == symbolBits
+        && !memcmp(&g_data.spec, spec, sizeof(*spec)))
+        return g_data.data;
+
+    HIST_free(g_data.data, g_data.size);
+    g_data.data = HIST_alloc(size, g_allocFlags, g_allocNode);
+    if (!g_data.data) { BMK_DISPLAY("Not enough memory for %u MB\n", (U32)(size >> 20)); exit(1); }
+    if (g_touchThreads) HIST_firstTouch(g_data.data, size, g_touchThreads);
+    g_data.size = size;
+    g_data.spec = *spec;
+    g_data.symbolBits = symbolBits;
+
+    DG_specName(spec, specName, sizeof(specName));
+    if (symbolBits) {
+        DG_generate16(g_data.data, size / 2, spec, symbolBits);
+        g_inputEntropy = -1;
+        BMK_DISPLAY("\nGenerating %i K %u-bit symbols with P=%.2f%%\n", (int)(size >> 11), symbolBits, spec->param*100);
+    } else {
+        DG_generate(g_data.data, size, spec);
+        g_inputEntropy = DG_measureEntropy(g_data.data, size);
+        BMK_DISPLAY("\nGenerating %i KB %s seed %u : %.3f bits/byte\n", (int)(size >> 10), specName,
+                    spec->seed, g_inputEntropy);
+    }
+    return g_data.data;
 }
 
-static void BMK_genData(void* buffer, size_t buffSize, double p)
-{
-    char table[PROBATABLESIZE];
-    int remaining = PROBATABLESIZE;
-    unsigned pos = 0;
-    unsigned s = 0;
-    char* op = (char*) buffer;
-    char* oend = op + buffSize;
-    unsigned seed = 1;
-    static unsigned done = 0;
-
-    if (p<0.01) p = 0.005;
-    if (p>1.) p = 1.;
-    if (!done)
-        {
-            done = 1;
-            BMK_DISPLAY("\nGenerating %i KB with P=%.2f%%\n", (int)(buffSize >> 10), p*100);
-        }
-
-    // Build Table
-    while (remaining)
-        {
-            unsigned n = (unsigned)(remaining * p);
-            unsigned end;
-            if (!n) n=1;
-            end = pos + n;
-            while (pos<end) table[pos++]=(char)s;
-            s++;
-            remaining -= n;
-        }
+// -f: benchmark on a file instead of generated data.  The file is mapped
+// read-only and walked block by block.  If it fits comfortably in memory
+// it is read in once before timing; larger files are streamed from disk
+// with sequential readahead, and then the timings include I/O.
+static const BYTE* g_fileData = NULL;
+static size_t g_fileSize = 0;
+static const char* g_fileName = NULL;
 
-    // Fill buffer
-    while (op<oend)
-        {
-            const unsigned r = BMK_rand(&seed) & (PROBATABLESIZE-1);
-            *op++ = table[r];
-        }
-}
-
-int trivialCount(uint8_t* src, size_t srcSize)
+static int BMK_mapFile(const char* fileName)
 {
-    U32 count[256];  // 256 counters starting at zero
-    memset(count, 0, sizeof(count));
-
-    // increment counter in bin matching each byte
-    uint8_t *end  = src + srcSize;
-    while (src < end) {
-        DEBUG_ACTIVE(printf("%d ", *src * 4));
-        count[*src++]++;
+    struct stat st;
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) || st.st_size == 0) {
+        BMK_DISPLAY("Cannot read %s\n", fileName);
+        if (fd >= 0) close(fd);
+        return 1;
     }
-
-    if (DEBUG_IS_ACTIVE) {
-        printf("\n");
-        for (int i = 0; i < 256; i++) {
-            printf("%d ", count[i]);
-        }
-        printf("\n");
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) { BMK_DISPLAY("Cannot map %s\n", fileName); return 1; }
+    madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t memSize = (size_t)sysconf(_SC_PHYS_PAGES) * pageSize;
+    g_fileData = data;
+    g_fileSize = (size_t)st.st_size;
+    g_fileName = fileName;
+    if (g_fileSize <= memSize / 2) {
+        volatile BYTE sink = 0;
+        madvise(data, g_fileSize, MADV_WILLNEED);
+        for (size_t pos = 0; pos < g_fileSize; pos += pageSize) sink += g_fileData[pos];
+        g_inputEntropy = DG_measureEntropy(g_fileData, g_fileSize);
+        BMK_DISPLAY("Loaded %s (%u KB) : %.3f bits/byte\n", fileName, (U32)(g_fileSize >> 10), g_inputEntropy);
+    } else {
+        BMK_DISPLAY("Streaming %s (%u MB, more than half of RAM) : timings include I/O\n",
+                    fileName, (U32)(g_fileSize >> 20));
     }
+    return 0;
+}
 
-    return count[0];
+static const char* BMK_inputName(const DG_spec_t* spec)
+{
+    static char specName[32];
+    if (g_fileName) return g_fileName;
+    DG_specName(spec, specName, sizeof(specName));
+    return specName;
 }
 
-// overallocate individual count tables to avoid 4K aliasing of 
-// same byte within different tables (helps avoid CPU misspeculation)
-#define COUNT_SIZE (256 + 8)
+static size_t g_blockSize = 0;  // -B, 0 = the defaults above
+static U32 g_threadsSet = 0;    // -T given, even -T1: large blocks
+static size_t g_streamChunkSize = DEFAULT_STREAM_CHUNK;
 
-#define ASM_INC_OFFSET_BASE_INDEX_SCALE(base, offset, index, scale)     \
-    __asm volatile ("incl %c0(%1, %2, %c3)":                            \
-                    :    /* no registers written (only memory) */       \
-                    "i" (offset), /* constant array offset */           \
-                    "r" (base),  /* read only */                        \
-                    "r" (index),  /* read only */                       \
-                    "i" (scale):  /* constant [1,2,4,8] */              \
-                    "memory" /* clobbers */                             \
-                    )
+// Feed the buffer through the streaming API in g_streamChunkSize pieces
+static int BMK_streamCount(const uint8_t *src, size_t srcSize, U32 *count)
+{
+    HIST_stream_t stream;
+
+    HIST_streamInit(&stream);
+    while (srcSize) {
+        size_t chunkSize = srcSize < g_streamChunkSize ? srcSize : g_streamChunkSize;
+        HIST_streamUpdate(&stream, src, chunkSize);
+        src += chunkSize;
+        srcSize -= chunkSize;
+    }
+    return HIST_streamFinalize(&stream, count);
+}
 
-// This function is limited by the number of uops in the loop.  Sustained throughput is
-// limited to 4 per cycle, and we use about 100.   If you can figure out how to reduce the number
-// of uops in the loop (uops, not instructions) this loop should run faster.  
+static unsigned g_maxSymbol = 255;
 
-// try using vector shift with extract to utilize port 7
+// Kernel-shaped wrappers for the entry points taking a max symbol hint (-M)
+static int BMK_verticalCount(const uint8_t *src, size_t srcSize, U32 *count)
+{
+    return count_vertical(src, srcSize, count, g_maxSymbol);
+}
 
-typedef __m128i xmm_t;
-int count_vec(uint8_t *src, size_t srcSize)
+static int BMK_hintCount(const uint8_t *src, size_t srcSize, U32 *count)
 {
-    static U32 count[16][COUNT_SIZE];
-    memset(count, 0, sizeof(count));
-    size_t remainder = srcSize % 16;
-    srcSize = srcSize - remainder;
-    xmm_t nextVec = _mm_loadu_si128((xmm_t *)&src[0]);
+    return HIST_countHint(src, srcSize, count, g_maxSymbol);
+}
 
-    /* IACA_START; */
-    for (size_t i = 16; i <= srcSize; i += 16) {
+static int BMK_limitedCount(const uint8_t *src, size_t srcSize, U32 *count)
+{
+    unsigned maxSymbol = g_maxSymbol;
+    if (HIST_countLimited(src, srcSize, count, &maxSymbol) == HIST_ERROR) {
+        BMK_DISPLAY("\nError : data has symbols above -M%u\n", g_maxSymbol);
+        return -1;
+    }
+    return count[0];
+}
 
-        uint64_t byte;
+static unsigned g_symbolBits = HIST_MAX_SYMBOL_BITS;
+static HIST_kernel16_t g_kernel16;
+static U32 g_count16[1 << HIST_MAX_SYMBOL_BITS];
 
-        xmm_t vec = nextVec;
-        nextVec = _mm_loadu_si128((xmm_t *)&src[i]);
+// 16-bit kernels in kernel shape: the buffer holds srcSize/2 symbols (-W bits)
+static int BMK_count16(const uint8_t *src, size_t srcSize, U32 *count)
+{
+    int result = g_kernel16((const U16 *)src, srcSize / 2, g_count16, g_symbolBits);
+    (void)count;
+    return result;
+}
 
-        byte = _mm_extract_epi8(vec, 0);
-        ASM_INC_OFFSET_BASE_INDEX_SCALE(count, COUNT_SIZE * 4 * 0, byte, 4);
+static U32 g_batchSize = DEFAULT_BATCH;
+static U32 g_batchCounts[MAX_BATCH][HIST_SYMBOLS];
 
-        byte = _mm_extract_epi8(vec, 1);
-        ASM_INC_OFFSET_BASE_INDEX_SCALE(count, COUNT_SIZE * 4 * 1, byte, 4);
+// Cut the buffer into BATCH_BLOCKSIZE blocks, counted g_batchSize (-K) at a
+// time, and sum the per-block histograms into count[] (the same 256 adds
+// per block in both, so -b34 and -b35 stay comparable)
+static int BMK_batchCount(const uint8_t *src, size_t srcSize, U32 *count)
+{
+    HIST_job_t jobs[MAX_BATCH];
+
+    memset(count, 0, HIST_SYMBOLS * sizeof(*count));
+    while (srcSize) {
+        size_t nbJobs = 0;
+        while (srcSize && nbJobs < g_batchSize) {
+            size_t blockSize = srcSize < BATCH_BLOCKSIZE ? srcSize : BATCH_BLOCKSIZE;
+            jobs[nbJobs].src = src;
+            jobs[nbJobs].srcSize = blockSize;
+            jobs[nbJobs].count = g_batchCounts[nbJobs];
+            nbJobs++;
+            src += blockSize;
+            srcSize -= blockSize;
+        }
+        HIST_countBatch(jobs, nbJobs);
+        for (size_t j = 0; j < nbJobs; j++)
+            for (int i = 0; i < HIST_SYMBOLS; i++) count[i] += g_batchCounts[j][i];
+    }
+    return count[0];
+}
 
-        byte = _mm_extract_epi8(vec, 2);
-        ASM_INC_OFFSET_BASE_INDEX_SCALE(count, COUNT_SIZE * 4 * 2, byte, 4);
+// Same blocks, one HIST_count() call each, for comparison
+static int BMK_blockCount(const uint8_t *src, size_t srcSize, U32 *count)
+{
+    memset(count, 0, HIST_SYMBOLS * sizeof(*count));
+    while (srcSize) {
+        size_t blockSize = srcSize < BATCH_BLOCKSIZE ? srcSize : BATCH_BLOCKSIZE;
+        HIST_count(src, blockSize, g_batchCounts[0]);
+        for (int i = 0; i < HIST_SYMBOLS; i++) count[i] += g_batchCounts[0][i];
+        src += blockSize;
+        srcSize -= blockSize;
+    }
+    return count[0];
+}
 
-        byte = _mm_extract_epi8(vec, 3);
-        ASM_INC_OFFSET_BASE_INDEX_SCALE(count, COUNT_SIZE * 4 * 3, byte, 4);
+// The other library entry points in kernel shape, so --verify and --guard
+// go through their chunk, slice and table edges too.  Thread counts and
+// piece sizes are odd on purpose: remainders land in the last chunk.
+#define WRAPPER_THREADS 3
+static const size_t g_unevenSizes[] = { 1, 15, 16, 17, 255, 4099, 63, 2 };
+#define NB_UNEVENSIZES (sizeof(g_unevenSizes) / sizeof(*g_unevenSizes))
 
-        byte = _mm_extract_epi8(vec, 4);
-        ASM_INC_OFFSET_BASE_INDEX_SCALE(count, COUNT_SIZE * 4 * 4, byte, 4);
+static int BMK_parallelCount(const uint8_t *src, size_t srcSize, U32 *count)
+{
+    return HIST_countParallel(HIST_count, src, srcSize, count, WRAPPER_THREADS);
+}
 
-        byte = _mm_extract_epi8(vec, 5);
-        ASM_INC_OFFSET_BASE_INDEX_SCALE(count, COUNT_SIZE * 4 * 5, byte, 4);
+static int BMK_count64(const uint8_t *src, size_t srcSize, U32 *count)
+{
+    U64 count64[HIST_SYMBOLS];
+    HIST_count64(HIST_count, src, srcSize, count64);
+    for (int i = 0; i < HIST_SYMBOLS; i++) count[i] = (U32)count64[i];
+    return count[0];
+}
 
-        byte = _mm_extract_epi8(vec, 6);
-        ASM_INC_OFFSET_BASE_INDEX_SCALE(count, COUNT_SIZE * 4 * 6, byte, 4);
+static int BMK_parallel64Count(const uint8_t *src, size_t srcSize, U32 *count)
+{
+    U64 count64[HIST_SYMBOLS];
+    HIST_countParallel64(HIST_count, src, srcSize, count64, WRAPPER_THREADS);
+    for (int i = 0; i < HIST_SYMBOLS; i++) count[i] = (U32)count64[i];
+    return count[0];
+}
 
-        byte = _mm_extract_epi8(vec, 7);
-        ASM_INC_OFFSET_BASE_INDEX_SCALE(count, COUNT_SIZE * 4 * 7, byte, 4);
+// Uneven pieces spread over two table sets, reduced together at the end
+static int BMK_tablesCount(const uint8_t *src, size_t srcSize, U32 *count)
+{
+    static HIST_tables_t tables[2];
+    size_t piece = 0;
+
+    HIST_tablesInit(&tables[0]);
+    HIST_tablesInit(&tables[1]);
+    while (srcSize) {
+        size_t size = g_unevenSizes[piece % NB_UNEVENSIZES];
+        if (size > srcSize) size = srcSize;
+        HIST_countTables(&tables[piece & 1], src, size);
+        piece++;
+        src += size;
+        srcSize -= size;
+    }
+    return HIST_reduceTables(tables, 2, count);
+}
 
-        byte = _mm_extract_epi8(vec, 8);
-        ASM_INC_OFFSET_BASE_INDEX_SCALE(count, COUNT_SIZE * 4 * 8, byte, 4);
+// HIST_stream with uneven updates, to exercise the carried-over tail
+static int BMK_unevenStreamCount(const uint8_t *src, size_t srcSize, U32 *count)
+{
+    HIST_stream_t stream;
+    size_t piece = 0;
+
+    HIST_streamInit(&stream);
+    while (srcSize) {
+        size_t size = g_unevenSizes[piece++ % NB_UNEVENSIZES];
+        if (size > srcSize) size = srcSize;
+        HIST_streamUpdate(&stream, src, size);
+        src += size;
+        srcSize -= size;
+    }
+    return HIST_streamFinalize(&stream, count);
+}
 
-        byte = _mm_extract_epi8(vec, 9);
-        ASM_INC_OFFSET_BASE_INDEX_SCALE(count, COUNT_SIZE * 4 * 9, byte, 4);
+// Scalar reference for the 16-bit kernels
+static void BMK_reference16(const U16 *src, size_t nbSymbols, U32 *count, unsigned symbolBits)
+{
+    const unsigned mask = (1U << symbolBits) - 1;
+    memset(count, 0, ((size_t)1 << symbolBits) * sizeof(*count));
+    for (size_t i = 0; i < nbSymbols; i++) count[src[i] & mask]++;
+}
 
-        byte = _mm_extract_epi8(vec, 10);
-        ASM_INC_OFFSET_BASE_INDEX_SCALE(count, COUNT_SIZE * 4 * 10, byte, 4);
+// Per-call samples: each BMK_timeLoop() cuts its iterations into up to
+// SAMPLES_PER_LOOP slices timed with the TSC, and appends the time per
+// call of each slice here.  fullSpeedBench() resets them per kernel.
+#define SAMPLES_PER_LOOP 256
+#define MAX_SAMPLES 4096
+static double g_sampleNs[MAX_SAMPLES];
+static size_t g_nbSamples;
+static double g_cyclesPerCall;  // of the last BMK_timeLoop()
+static double g_tscMHz = 0;
+
+// Time nbIterations calls of size bytes, returning milliseconds per call.
+// Successive calls walk through buffer[0..bufferSize) and wrap around.
+// longCounters selects the 64-bit totals entry points instead of the kernel.
+static double BMK_timeLoop(const char* funcName, HIST_kernel_t func, const void* buffer, size_t bufferSize,
+                           size_t size, U32 nbThreads, U32 longCounters, U32 nbIterations, int* errorCode)
+{
+    U32 count[HIST_SYMBOLS];
+    U64 count64[HIST_SYMBOLS];
+    U32 nbSlices = nbIterations < SAMPLES_PER_LOOP ? nbIterations : SAMPLES_PER_LOOP;
+    U64 sliceCycles[SAMPLES_PER_LOOP];
+    U32 sliceCalls[SAMPLES_PER_LOOP];
+    U32 i = 0;
+    size_t offset = 0;
+    (void)funcName;  // only used by likwid
+
+    likwid_markerStartRegion(funcName);
+
+    U64 startNs = BMK_clockNs();
+    U64 startCycles = BMK_cycles();
+    // fixed number of iterations (instead of fixed time in original)
+    for (U32 slice = 0; slice < nbSlices; slice++)
+        {
+            U32 sliceEnd = (U32)((U64)nbIterations * (slice + 1) / nbSlices);
+            U64 sliceStart = BMK_cycles();
+            sliceCalls[slice] = sliceEnd - i;
+            for (; i < sliceEnd; i++)
+                {
+                    const BYTE* src = (const BYTE*)buffer + offset;
+                    if (longCounters)
+                        *errorCode = (int)HIST_countParallel64(func, src, size, count64, nbThreads);
+                    else if (nbThreads > 1) 
+                        *errorCode = HIST_countParallel(func, src, size, count, nbThreads);
+                    else
+                        *errorCode = func(src, size, count);
+                    if (*errorCode < 0) exit(-1);
+                    offset += size;
+                    if (offset + size > bufferSize) offset = 0;
+                }
+            sliceCycles[slice] = BMK_cycles() - sliceStart;
+        }
+    U64 totalCycles = BMK_cycles() - startCycles;
+    U64 totalNs = BMK_clockNs() - startNs;
 
-        byte = _mm_extract_epi8(vec, 11);
-        ASM_INC_OFFSET_BASE_INDEX_SCALE(count, COUNT_SIZE * 4 * 11, byte, 4);
+    likwid_markerStopRegion(funcName);
 
-        byte = _mm_extract_epi8(vec, 12);
-        ASM_INC_OFFSET_BASE_INDEX_SCALE(count, COUNT_SIZE * 4 * 12, byte, 4);
+    // the clock converts TSC slices to ns, no calibration needed
+    double nsPerCycle = totalCycles ? (double)totalNs / totalCycles : 0;
+    for (U32 slice = 0; slice < nbSlices && g_nbSamples < MAX_SAMPLES && !longCounters; slice++)
+        g_sampleNs[g_nbSamples++] = sliceCycles[slice] * nsPerCycle / sliceCalls[slice];
 
-        byte = _mm_extract_epi8(vec, 13);
-        ASM_INC_OFFSET_BASE_INDEX_SCALE(count, COUNT_SIZE * 4 * 13, byte, 4);
+    g_cyclesPerCall = nbIterations ? (double)totalCycles / nbIterations : 0;
+    if (totalNs) g_tscMHz = (double)totalCycles * 1000. / totalNs;
+    return nbIterations ? (double)totalNs / 1e6 / nbIterations : 0;
+}
 
-        byte = _mm_extract_epi8(vec, 14);
-        ASM_INC_OFFSET_BASE_INDEX_SCALE(count, COUNT_SIZE * 4 * 14, byte, 4);
+static int BMK_compareDouble(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
 
-        byte = _mm_extract_epi8(vec, 15);
-        ASM_INC_OFFSET_BASE_INDEX_SCALE(count, COUNT_SIZE * 4 * 15, byte, 4);
+// min, median and 99th percentile of the samples, in ns per call, and
+// their coefficient of variation (standard deviation / mean)
+static void BMK_sampleStats(double* minNs, double* medianNs, double* p99Ns, double* cv)
+{
+    double sum = 0, sumSquares = 0;
+    size_t n = g_nbSamples;
+
+    *minNs = *medianNs = *p99Ns = *cv = 0;
+    if (!n) return;
+    qsort(g_sampleNs, n, sizeof(*g_sampleNs), BMK_compareDouble);
+    for (size_t i = 0; i < n; i++) sum += g_sampleNs[i], sumSquares += g_sampleNs[i] * g_sampleNs[i];
+    double mean = sum / n;
+    double variance = sumSquares / n - mean * mean;
+    *minNs = g_sampleNs[0];
+    *medianNs = g_sampleNs[n / 2];
+    *p99Ns = g_sampleNs[(n * 99) / 100 < n ? (n * 99) / 100 : n - 1];
+    *cv = variance > 0 ? sqrt(variance) / mean : 0;
+}
 
+// Hardware counters (--perf), read with perf_event_open around the timed
+// loops of fullSpeedBench.  Events the kernel or the CPU refuses (VMs
+// often have no PMU at all) are left out; raw codes are Intel only.
+#define PERF_L1D_READ_MISS (PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+                            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+static const struct {
+    const char* name;
+    U32 type;
+    U64 config;
+    U32 intelOnly;
+} g_perfEvents[] = {
+    { "cycles",       PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,   0 },
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 0 },
+    { "uops",         PERF_TYPE_RAW,      0x010E, 1 },  // UOPS_ISSUED.ANY
+    { "L1Dmiss",      PERF_TYPE_HW_CACHE, PERF_L1D_READ_MISS, 0 },
+    { "clears",       PERF_TYPE_RAW,      0x02C3, 1 },  // MACHINE_CLEARS.MEMORY_ORDERING
+    { "alias4K",      PERF_TYPE_RAW,      0x0107, 1 },  // LD_BLOCKS_PARTIAL.ADDRESS_ALIAS
+};
+#define NB_PERFEVENTS (sizeof(g_perfEvents) / sizeof(*g_perfEvents))
+enum { PERF_CYCLES, PERF_INSTRUCTIONS };
+
+static int g_perfFd[NB_PERFEVENTS];
+static U32 g_perfEnabled = 0;  // --perf, and at least one counter opened
+static double g_perfCount[NB_PERFEVENTS];  // since the last BMK_perfReset()
+
+static void BMK_perfOpen(void)
+{
+    U32 nbOpened = 0;
+    int lastErrno = 0;
+
+    for (size_t e = 0; e < NB_PERFEVENTS; e++) {
+        struct perf_event_attr attr;
+        g_perfFd[e] = -1;
+        if (g_perfEvents[e].intelOnly && !__builtin_cpu_is("intel")) continue;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = g_perfEvents[e].type;
+        attr.config = g_perfEvents[e].config;
+        attr.disabled = 1;
+        attr.inherit = 1;  // include -T worker threads
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        g_perfFd[e] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (g_perfFd[e] < 0) lastErrno = errno;
+        else nbOpened++;
     }
+    g_perfEnabled = nbOpened > 0;
+    if (!g_perfEnabled)
+        BMK_DISPLAY("perf counters unavailable (%s), continuing without\n", strerror(lastErrno));
+}
 
-    src += srcSize;  // skip over the finished part
-    for (size_t i = 0; i < remainder; i++) {
-        uint64_t byte = src[i];
-        ASM_INC_OFFSET_BASE_INDEX_SCALE(count, 0, byte, 4);
-    }
+static void BMK_perfReset(void)
+{
+    memset(g_perfCount, 0, sizeof(g_perfCount));
+}
 
-    // sum 256 byte counters in 16 separate arrays into count[0][byte]
-    for (int i = 0; i < 256; i++) {
-        for (int idx=1; idx < 16; idx++) {
-            count[0][i] += count[idx][i];
-        }
+static void BMK_perfStart(void)
+{
+    if (!g_perfEnabled) return;
+    for (size_t e = 0; e < NB_PERFEVENTS; e++)
+        if (g_perfFd[e] >= 0) ioctl(g_perfFd[e], PERF_EVENT_IOC_RESET, 0);
+    for (size_t e = 0; e < NB_PERFEVENTS; e++)
+        if (g_perfFd[e] >= 0) ioctl(g_perfFd[e], PERF_EVENT_IOC_ENABLE, 0);
+}
+
+// Stop counting and add to g_perfCount, scaled up if the events were
+// multiplexed (more events than the core has counters)
+static void BMK_perfStop(void)
+{
+    if (!g_perfEnabled) return;
+    for (size_t e = 0; e < NB_PERFEVENTS; e++)
+        if (g_perfFd[e] >= 0) ioctl(g_perfFd[e], PERF_EVENT_IOC_DISABLE, 0);
+    for (size_t e = 0; e < NB_PERFEVENTS; e++) {
+        U64 value[3];  // count, time enabled, time running
+        if (g_perfFd[e] < 0) continue;
+        if (read(g_perfFd[e], value, sizeof(value)) != sizeof(value) || !value[2]) continue;
+        g_perfCount[e] += (double)value[0] * value[1] / value[2];
     }
+}
 
-    return count[0][0];
+// IPC and every other event per byte, for the result line
+static void BMK_perfDisplay(double nbBytes)
+{
+    if (!g_perfEnabled) return;
+    if (g_perfFd[PERF_CYCLES] >= 0 && g_perfFd[PERF_INSTRUCTIONS] >= 0 && g_perfCount[PERF_CYCLES] > 0)
+        BMK_DISPLAY("  IPC %.2f", g_perfCount[PERF_INSTRUCTIONS] / g_perfCount[PERF_CYCLES]);
+    for (size_t e = 0; e < NB_PERFEVENTS; e++)
+        if (g_perfFd[e] >= 0 && e != PERF_INSTRUCTIONS)
+            BMK_DISPLAY("  %s/B %.3f", g_perfEvents[e].name, g_perfCount[e] / nbBytes);
 }
 
+// Machine-readable results (--format=csv|json): one record per kernel run
+// on stdout, with enough about the host and build to compare runs across
+// machines.  Human-readable progress stays on stderr.
+enum { FORMAT_TEXT, FORMAT_CSV, FORMAT_JSON };
+static U32 g_format = FORMAT_TEXT;
+
+// compiler flags are not visible to the program: pass -DBMK_CFLAGS='"$CFLAGS"'
+// to record them, otherwise the instruction set macros they imply are listed
+#ifndef BMK_CFLAGS
+#  define BMK_FLAG(macro) " " #macro
+#  ifdef __OPTIMIZE__
+#    define BMK_FLAG_OPTIMIZE BMK_FLAG(__OPTIMIZE__)
+#  else
+#    define BMK_FLAG_OPTIMIZE ""
+#  endif
+#  ifdef __AVX__
+#    define BMK_FLAG_AVX BMK_FLAG(__AVX__)
+#  else
+#    define BMK_FLAG_AVX ""
+#  endif
+#  ifdef __AVX2__
+#    define BMK_FLAG_AVX2 BMK_FLAG(__AVX2__)
+#  else
+#    define BMK_FLAG_AVX2 ""
+#  endif
+#  ifdef __AVX512F__
+#    define BMK_FLAG_AVX512 BMK_FLAG(__AVX512F__)
+#  else
+#    define BMK_FLAG_AVX512 ""
+#  endif
+#  define BMK_CFLAGS ("" BMK_FLAG_OPTIMIZE BMK_FLAG_AVX BMK_FLAG_AVX2 BMK_FLAG_AVX512 + 1)
+#endif
 
-// Port 7 friendly increment
-#define ASM_INC_OFFSET_BASE_INDEX(offset, base, index)                  \
-    __asm volatile (                                                    \
-                    "incl %c0+%c1(%2)\n":                               \
-                    : /* nothing written except memory */               \
-                    "i" (offset),  /* which array */                    \
-                    "p" (base),    /* array base */                     \
-                    "r" (index):   /* pre-shifted index */              \
-                    "memory" /* clobbers */                             \
-                                                                        )
-
-#define ASM_LOAD_WORD_FROM_BUFFER(buffer, offset, dest)                 \
-    __asm volatile (                                                    \
-                    "movzwl %c1(%2), %k0\n":                            \
-                    "=r" (dest) :  /* 32-bit write */                   \
-                    "i" (offset),  /* byte offset */                    \
-                    "r" (buffer)  /* buffer base */                     \
-                                                                        )
-
-
-#define ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(offset, ptr, index, scale, destVec) \
-    __asm volatile (                                                    \
-                    "vpmovzxbw %c1(%2, %3, %c4), %0\n":                 \
-                    "=x" (destVec) :  /* vector write */                \
-                    "i" (offset),                                       \
-                    "r" (ptr),   /* ptr */                              \
-                    "r" (index),  /* offset */                          \
-                    "i" (scale)  /* [1,2,4,8] */                        \
-                                                                        )
-
-#define ASM_COMPILER_MEM_BARRIER()                                      \
-    __asm volatile( "" /* no asm */ :                                   \
-                    /* nothing written */ :                             \
-                    /* nothing read */ :                                \
-                    /* pretend to clobber */ "memory");
-
-
-#ifdef __AVX2__
-typedef __m256i ymm_t;
-int port7vec(uint8_t *src, size_t srcSize)
+typedef struct {
+    const char* kernel;
+    U32 algNb;
+    const char* isa;
+    size_t blockSize;
+    const char* input;    // -f file, or the generator spec
+    U32 seed;
+    double entropy;       // bits/byte, < 0 if unknown
+    U32 nbThreads;
+    U32 nbIterations;
+    U32 nbLoops;
+    double nsPerCall;     // best loop
+    double cyclesPerByte; // TSC, best loop
+    double minNs, medianNs, p99Ns, cv;
+    int checksum;
+    double nsPerCall64;   // -L, 0 if not timed
+} BMK_result_t;
+
+static char g_cpuModel[128] = "unknown";
+static double g_cpuMHz = 0;
+
+static void BMK_readCpuInfo(void)
 {
-    static U32 count[16][COUNT_SIZE];
-    memset(count, 0, sizeof(count));
-
-    // 2x32B buffers with 64B alignment
-    uint8_t *buffer = memalign(2*32, 64); 
-    
-    // index == byte * 4 (pre-shifted)
-    uint64_t index0, index1, index2, index3;
-    uint64_t index4, index5, index6, index7;
-
-    ASM_COMPILER_MEM_BARRIER();
-
-    ymm_t vec0, vec1;
-    vec0 = _mm256_cvtepu8_epi16(*(xmm_t *)&src[0]);
-    vec0 = _mm256_slli_epi16(vec0, 2);
-    _mm256_store_si256((ymm_t *)buffer, vec0);
-
-    ASM_COMPILER_MEM_BARRIER();
-
-    DEBUG_PRINT("Original src %p endSrc %p loaded %p ", src, src + srcSize, &src[0]);
-    
-    // start with registers loaded
-    ASM_LOAD_WORD_FROM_BUFFER(buffer, 0 * 2, index0);
-    ASM_LOAD_WORD_FROM_BUFFER(buffer, 1 * 2, index1);
-    ASM_LOAD_WORD_FROM_BUFFER(buffer, 2 * 2, index2);
-    ASM_LOAD_WORD_FROM_BUFFER(buffer, 3 * 2, index3);
-    ASM_LOAD_WORD_FROM_BUFFER(buffer, 4 * 2, index4);
-    ASM_LOAD_WORD_FROM_BUFFER(buffer, 5 * 2, index5);
-    ASM_LOAD_WORD_FROM_BUFFER(buffer, 6 * 2, index6);
-    ASM_LOAD_WORD_FROM_BUFFER(buffer, 7 * 2, index7);
-    src += 8;
-    srcSize -= 8;
-
-    size_t remainder = srcSize % 32;
-    remainder += 64;
-    srcSize = srcSize - remainder;
-    uint8_t *endSrc = src + srcSize;
-    int64_t negCount = -srcSize;
-
-
-    // need to start with both buffers full
-    ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(0, endSrc, negCount, 1, vec1);
-    vec1 = _mm256_slli_epi16(vec1, 2);
-    _mm256_store_si256((ymm_t *)buffer, vec1);
-
-    ASM_COMPILER_MEM_BARRIER();
-
-    ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(16, endSrc, negCount, 1, vec0);
-    vec0 = _mm256_slli_epi16(vec0, 2);
-    _mm256_store_si256((ymm_t *)(buffer + 32), vec0);
-
-    ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(32, endSrc, negCount, 1, vec0); 
-
-    IACA_START;
-
-    while (negCount != 0) {
-        // software prefetch because hardware does not cross 4K pages
-        _mm_prefetch((const char *)(endSrc + negCount + 768), 3);
-
-        vec0 = _mm256_slli_epi16(vec0, 2);
-
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 0, index0);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 0 * 2, index0);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 1, index1);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 1 * 2, index1);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 2, index2);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 2 * 2, index2);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 3, index3);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 3 * 2, index3);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 4, index4);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 4 * 2, index4);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 5, index5);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 5 * 2, index5);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 6, index6);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 6 * 2, index6);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 7, index7);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 7 * 2, index7);
-
-        ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(48, endSrc, negCount, 1, vec1); 
-
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 8, index0);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 8 * 2, index0);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 9, index1);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 9 * 2, index1);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 10, index2);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 10 * 2, index2);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 11, index3);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 11 * 2, index3);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 12, index4);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 12 * 2, index4);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 13, index5);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 13 * 2, index5);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 14, index6);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 14 * 2, index6);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 15, index7);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 15 * 2, index7);
-
-
-        vec1 = _mm256_slli_epi16(vec1, 2);
-        _mm256_store_si256((ymm_t *)buffer, vec0);
-
-
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 0, index0);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 0 * 2, index0);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 1, index1);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 1 * 2, index1);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 2, index2);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 2 * 2, index2);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 3, index3);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 3 * 2, index3);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 4, index4);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 4 * 2, index4);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 5, index5);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 5 * 2, index5);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 6, index6);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 6 * 2, index6);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 7, index7);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 7 * 2, index7);
-
-        //        ASM_COMPILER_MEM_BARRIER();
-        ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(64, endSrc, negCount, 1, vec0); 
-
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 8, index0);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 8 * 2, index0);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 9, index1);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 9 * 2, index1);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 10, index2);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 10 * 2, index2);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 11, index3);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 11 * 2, index3);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 12, index4);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 12 * 2, index4);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 13, index5);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 13 * 2, index5);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 14, index6);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 14 * 2, index6);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 15, index7);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 15 * 2, index7);
-
-        _mm256_store_si256((ymm_t *)(buffer + 32), vec1);
-
-        negCount += 32;
+    char line[256];
+    FILE* f = fopen("/proc/cpuinfo", "r");
+    if (!f) return;
+    while (fgets(line, sizeof(line), f)) {
+        char* value = strchr(line, ':');
+        if (!value) continue;
+        value += 1 + (value[1] == ' ');
+        value[strcspn(value, "\n")] = 0;
+        if (!strncmp(line, "model name", 10)) snprintf(g_cpuModel, sizeof(g_cpuModel), "%s", value);
+        if (!strncmp(line, "cpu MHz", 7)) { g_cpuMHz = atof(value); break; }
     }
+    fclose(f);
+}
 
-    IACA_END;
-
-    remainder += 8;  // loaded to registers but unused
-    endSrc -= 8;     // portion that needs to be reread
+// Variant's instruction set, if func is a library kernel
+static const char* BMK_kernelIsa(HIST_kernel_t func)
+{
+    size_t nbVariants;
+    const HIST_variant_t* variants = HIST_variants(&nbVariants);
+    for (size_t v = 0; v < nbVariants; v++)
+        if (variants[v].kernel == func) return HIST_isaName(variants[v].isa);
+    return "";
+}
 
-    DEBUG_PRINT("|");
-    for (size_t i = 0; i < remainder; i++) {
-        uint64_t byte = endSrc[i];
-        DEBUG_PRINT("%ld ", byte * 4);
-        count[0][byte]++;
+static void BMK_printString(const char* str)
+{
+    putchar('"');
+    for (; *str; str++) {
+        if (*str == '"') printf(g_format == FORMAT_JSON ? "\\\"" : "\"\"");
+        else if (*str == '\\' && g_format == FORMAT_JSON) printf("\\\\");
+        else if ((unsigned char)*str >= ' ') putchar(*str);
     }
-    DEBUG_PRINT("\n");
+    putchar('"');
+}
 
-    // sum 256 byte counters in 16 separate arrays into count[0][byte]
-    for (int i = 0; i < 256; i++) {
-        for (int idx=1; idx < 16; idx++) {
-            count[0][i] += count[idx][i];
+static void BMK_emitResult(const BMK_result_t* r)
+{
+    static const char* const fields[] = {
+        "kernel", "alg", "isa", "blockSize", "input", "seed", "entropy", "threads", "iterations", "loops",
+        "MBps", "nsPerCall", "cyclesPerByte", "minNs", "medianNs", "p99Ns", "cv", "checksum",
+        "MBps64", "cpu", "cpuMHz", "tscMHz", "compiler", "flags" };
+    const char* const sep = g_format == FORMAT_JSON ? ", " : ",";
+    U32 f = 0;
+
+    if (g_format == FORMAT_TEXT) return;
+    if (g_format == FORMAT_CSV) {
+        static U32 headerDone = 0;
+        if (!headerDone) {
+            for (size_t h = 0; h < sizeof(fields) / sizeof(*fields); h++)
+                printf("%s%s", h ? "," : "", fields[h]);
+            printf("\n");
+            headerDone = 1;
         }
-        DEBUG_PRINT("%d ", count[0][i]);
     }
-    DEBUG_PRINT("\n");
-
+#define BMK_FIELD(...) do { \
+        if (f) printf("%s", sep); else if (g_format == FORMAT_JSON) printf("{"); \
+        if (g_format == FORMAT_JSON) printf("\"%s\": ", fields[f]); \
+        printf(__VA_ARGS__); f++; } while (0)
+#define BMK_FIELD_STRING(str) do { BMK_FIELD("%s", ""); BMK_printString(str); } while (0)
+    BMK_FIELD_STRING(r->kernel);
+    BMK_FIELD("%u", r->algNb);
+    BMK_FIELD_STRING(r->isa);
+    BMK_FIELD("%zu", r->blockSize);
+    BMK_FIELD_STRING(r->input);
+    BMK_FIELD("%u", r->seed);
+    if (r->entropy >= 0) BMK_FIELD("%.3f", r->entropy);
+    else BMK_FIELD("%s", g_format == FORMAT_JSON ? "null" : "");
+    BMK_FIELD("%u", r->nbThreads);
+    BMK_FIELD("%u", r->nbIterations);
+    BMK_FIELD("%u", r->nbLoops);
+    BMK_FIELD("%.1f", (double)r->blockSize / r->nsPerCall * 1000.);
+    BMK_FIELD("%.1f", r->nsPerCall);
+    BMK_FIELD("%.4f", r->cyclesPerByte);
+    BMK_FIELD("%.1f", r->minNs);
+    BMK_FIELD("%.1f", r->medianNs);
+    BMK_FIELD("%.1f", r->p99Ns);
+    BMK_FIELD("%.4f", r->cv);
+    BMK_FIELD("%d", r->checksum);
+    if (r->nsPerCall64 > 0) BMK_FIELD("%.1f", (double)r->blockSize / r->nsPerCall64 * 1000.);
+    else BMK_FIELD("%s", g_format == FORMAT_JSON ? "null" : "");
+    BMK_FIELD_STRING(g_cpuModel);
+    BMK_FIELD("%.0f", g_cpuMHz);
+    BMK_FIELD("%.0f", g_tscMHz);
+    BMK_FIELD_STRING(__VERSION__);
+    BMK_FIELD_STRING(BMK_CFLAGS);
+#undef BMK_FIELD_STRING
+#undef BMK_FIELD
+    printf(g_format == FORMAT_JSON ? "}\n" : "\n");
+    fflush(stdout);
+}
 
-    free(buffer);
+// Kernel registry: everything the benchmark can run, in id order.  The
+// library kernels come from HIST_variants(), one entry per family, so a
+// kernel added to the library's variant table shows up in -b, --list,
+// --verify and --sweep without touching this file.  The wrappers below
+// are the benchmark-only entries.
+// -b selects by id or by name pattern; props say which runs include it.
+#define BMK_DEFAULT  1  // benchmarked when -b is not given
+#define BMK_VERIFY   2  // checked by --verify and --guard (16-bit ones against a scalar count)
+#define BMK_BOUNDED  4  // writes only bins 0..-M
+#ifdef TESTING
+#  define BMK_TESTING BMK_DEFAULT
+#else
+#  define BMK_TESTING 0
+#endif
 
-    return count[0][0];
+typedef struct {
+    U32 id;
+    const char* name;
+    HIST_isa_t isa;           // least the kernel needs: skipped on CPUs without it
+    HIST_kernel_t func;
+    HIST_kernel16_t func16;   // 16-bit symbols, run through BMK_count16
+    U32 props;
+} BMK_kernel_t;
+
+// Ids the library families had before the registry was derived, so old
+// -b numbers keep working.  Families not listed get ids from
+// BMK_FIRST_NEW_ID up, in variant table order, and the default props.
+static const struct {
+    const char* name;
+    U32 id;
+    U32 props;
+} g_familyIds[] = {
+    { "trivialCount",  1, BMK_DEFAULT | BMK_VERIFY },
+    { "count2x64",     2, BMK_DEFAULT | BMK_VERIFY },
+    { "count_vec",     3, BMK_DEFAULT | BMK_VERIFY },
+    { "storePort7",    4, BMK_DEFAULT | BMK_VERIFY },
+    { "reloadPort7",   5, BMK_DEFAULT | BMK_VERIFY },
+    { "count8reload",  6, BMK_DEFAULT | BMK_VERIFY },
+    { "vecavx",        7, BMK_TESTING | BMK_VERIFY },
+    { "hist_4_128",   10, BMK_DEFAULT | BMK_VERIFY },
+    { "hist_8_128",   11, BMK_DEFAULT | BMK_VERIFY },
+    { "hist_4_32",    12, BMK_DEFAULT | BMK_VERIFY },
+    { "hist_4_64",    13, BMK_DEFAULT | BMK_VERIFY },
+    { "hist_8_64",    14, BMK_DEFAULT | BMK_VERIFY },
+    { "hist_16_64_u8",  15, BMK_DEFAULT | BMK_VERIFY },
+    { "hist_16_64_u16", 16, BMK_DEFAULT | BMK_VERIFY },
+    { "count_runs",   17, BMK_DEFAULT | BMK_VERIFY },
+    { "port7vec",     20, BMK_DEFAULT | BMK_VERIFY },
+    { "scatter512",   21, BMK_DEFAULT | BMK_VERIFY },
+};
+#define NB_FAMILYIDS (sizeof(g_familyIds) / sizeof(*g_familyIds))
+#define BMK_FIRST_NEW_ID 100
+
+static const BMK_kernel_t g_wrappers[] = {
+    { 18, "count_vertical",       HIST_ISA_AVX2,    BMK_verticalCount, NULL, BMK_VERIFY },
+    { 30, "HIST_stream",          HIST_ISA_GENERIC, BMK_streamCount,   NULL, BMK_DEFAULT | BMK_VERIFY },
+    { 31, "HIST_count",           HIST_ISA_GENERIC, HIST_count,        NULL, BMK_VERIFY },
+    { 32, "HIST_countHint",       HIST_ISA_GENERIC, BMK_hintCount,     NULL, BMK_VERIFY },
+    { 33, "HIST_countLimited",    HIST_ISA_GENERIC, BMK_limitedCount,  NULL, BMK_VERIFY | BMK_BOUNDED },
+    { 34, "HIST_countBatch",      HIST_ISA_GENERIC, BMK_batchCount,    NULL, BMK_VERIFY },
+    { 35, "HIST_count_per_block", HIST_ISA_GENERIC, BMK_blockCount,    NULL, BMK_VERIFY },
+    { 40, "count16_1x32",         HIST_ISA_GENERIC, BMK_count16,       count16_1x32, BMK_VERIFY },
+    { 41, "count16_4x32",         HIST_ISA_GENERIC, BMK_count16,       count16_4x32, BMK_VERIFY },
+    { 42, "count16_4x16",         HIST_ISA_GENERIC, BMK_count16,       count16_4x16, BMK_VERIFY },
+    { 43, "HIST_count16",         HIST_ISA_GENERIC, BMK_count16,       HIST_count16, BMK_VERIFY },
+    { 50, "HIST_countParallel",   HIST_ISA_GENERIC, BMK_parallelCount, NULL, BMK_VERIFY },
+    { 51, "HIST_count64",         HIST_ISA_GENERIC, BMK_count64,       NULL, BMK_VERIFY },
+    { 52, "HIST_countParallel64", HIST_ISA_GENERIC, BMK_parallel64Count, NULL, BMK_VERIFY },
+    { 53, "HIST_countTables",     HIST_ISA_GENERIC, BMK_tablesCount,   NULL, BMK_VERIFY },
+    { 54, "HIST_stream_uneven",   HIST_ISA_GENERIC, BMK_unevenStreamCount, NULL, BMK_VERIFY },
+};
+#define NB_WRAPPERS (sizeof(g_wrappers) / sizeof(*g_wrappers))
+
+#define MAX_KERNELS 128
+static BMK_kernel_t g_kernels[MAX_KERNELS];
+static size_t g_nbKernels;
+#define NB_KERNELS g_nbKernels
+
+static int BMK_compareKernelId(const void* a, const void* b)
+{
+    U32 x = ((const BMK_kernel_t*)a)->id, y = ((const BMK_kernel_t*)b)->id;
+    return (x > y) - (x < y);
 }
-#endif // __AVX2__
 
-int vecavx(uint8_t *src, size_t srcSize)
+// One entry per library family, with the lowest ISA of its variants (the
+// benchmark runs the best one this CPU supports), then the wrappers
+static void BMK_buildRegistry(void)
 {
-    static U32 count[16][COUNT_SIZE];
-    memset(count, 0, sizeof(count));
-
-    // 4x16B buffers with 64B alignment (overcommit for same offsets as AVX2)
-    uint8_t *buffer = memalign(4*16, 64); 
-    
-    // index == byte * 4 (pre-shifted)
-    uint64_t index0, index1, index2, index3;
-    uint64_t index4, index5, index6, index7;
-
-    xmm_t vec0, vec1, vec2, vec3;
-    vec0 = _mm_cvtepu8_epi16(*(xmm_t *)&src[0]);
-    vec0 = _mm_slli_epi16(vec0, 2);
-    vec1 = _mm_cvtepu8_epi16(*(xmm_t *)&src[16]);
-    vec1 = _mm_slli_epi16(vec1, 2);
-    _mm_store_si128((xmm_t *)(buffer +  0), vec0);
-    _mm_store_si128((xmm_t *)(buffer + 16), vec1);
-
-    ASM_COMPILER_MEM_BARRIER();
-
-    // start with registers loaded
-    ASM_LOAD_WORD_FROM_BUFFER(buffer, 0 * 2, index0);
-    ASM_LOAD_WORD_FROM_BUFFER(buffer, 1 * 2, index1);
-    ASM_LOAD_WORD_FROM_BUFFER(buffer, 2 * 2, index2);
-    ASM_LOAD_WORD_FROM_BUFFER(buffer, 3 * 2, index3);
-    ASM_LOAD_WORD_FROM_BUFFER(buffer, 4 * 2, index4);
-    ASM_LOAD_WORD_FROM_BUFFER(buffer, 5 * 2, index5);
-    ASM_LOAD_WORD_FROM_BUFFER(buffer, 6 * 2, index6);
-    ASM_LOAD_WORD_FROM_BUFFER(buffer, 7 * 2, index7);
-    src += 8;
-    srcSize -= 8;
-
-
-    size_t remainder = srcSize % 32;
-    remainder += 64;
-    srcSize = srcSize - remainder;
-    uint8_t *endSrc = src + srcSize;
-    int64_t negCount = -srcSize;
-
-    // need to start with both buffers full
-    ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(0, endSrc, negCount, 1, vec2);
-    ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(8, endSrc, negCount, 1, vec3);
-    vec2 = _mm_slli_epi16(vec2, 2);
-    _mm_store_si128((xmm_t *)(buffer + 0), vec2);
-    vec3 = _mm_slli_epi16(vec3, 2);
-    _mm_store_si128((xmm_t *)(buffer + 16), vec3);
-
-
-    ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(16, endSrc, negCount, 1, vec0);
-    ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(24, endSrc, negCount, 1, vec1);
-    vec0 = _mm_slli_epi16(vec0, 2);
-    _mm_store_si128((xmm_t *)(buffer + 32), vec0);
-    vec1 = _mm_slli_epi16(vec1, 2);
-    _mm_store_si128((xmm_t *)(buffer + 48), vec1);
-
-    ASM_COMPILER_MEM_BARRIER();
-
-    ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(32, endSrc, negCount, 1, vec0); 
-    ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(40, endSrc, negCount, 1, vec1); 
-
-    IACA_START;
-
-    while (negCount != 0) {
-        _mm_prefetch((const char *)(endSrc + negCount + 768), 3);
-        vec0 = _mm_slli_epi16(vec0, 2);
-        vec1 = _mm_slli_epi16(vec0, 2);
-
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 0, index0);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 0 * 2, index0);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 1, index1);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 1 * 2, index1);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 2, index2);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 2 * 2, index2);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 3, index3);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 3 * 2, index3);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 4, index4);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 4 * 2, index4);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 5, index5);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 5 * 2, index5);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 6, index6);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 6 * 2, index6);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 7, index7);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 7 * 2, index7);
-
-        ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(48, endSrc, negCount, 1, vec2); 
-        ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(56, endSrc, negCount, 1, vec3); 
-
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 8, index0);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 8 * 2, index0);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 9, index1);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 9 * 2, index1);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 10, index2);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 10 * 2, index2);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 11, index3);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 11 * 2, index3);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 12, index4);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 12 * 2, index4);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 13, index5);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 13 * 2, index5);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 14, index6);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 14 * 2, index6);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 15, index7);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 15 * 2, index7);
-
-
-        vec2 = _mm_slli_epi16(vec2, 2);
-        vec3 = _mm_slli_epi16(vec3, 2);
-        _mm_store_si128((xmm_t *)(buffer + 0), vec0);
-        _mm_store_si128((xmm_t *)(buffer + 16), vec1);
-
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 0, index0);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 0 * 2, index0);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 1, index1);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 1 * 2, index1);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 2, index2);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 2 * 2, index2);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 3, index3);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 3 * 2, index3);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 4, index4);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 4 * 2, index4);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 5, index5);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 5 * 2, index5);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 6, index6);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 6 * 2, index6);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 7, index7);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 7 * 2, index7);
-
-        ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(64, endSrc, negCount, 1, vec0); 
-        ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(72, endSrc, negCount, 1, vec1); 
-
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 8, index0);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 8 * 2, index0);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 9, index1);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 9 * 2, index1);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 10, index2);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 10 * 2, index2);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 11, index3);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 11 * 2, index3);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 12, index4);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 12 * 2, index4);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 13, index5);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 13 * 2, index5);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 14, index6);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 14 * 2, index6);
-        ASM_INC_OFFSET_BASE_INDEX(count, COUNT_SIZE * 4 * 15, index7);
-        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 15 * 2, index7);
-
-        _mm_store_si128((xmm_t *)(buffer + 32), vec2);
-        _mm_store_si128((xmm_t *)(buffer + 48), vec3);
-
-
-        negCount += 32;
+    size_t nbVariants;
+    const HIST_variant_t* variants = HIST_variants(&nbVariants);
+    U32 nextId = BMK_FIRST_NEW_ID;
+
+    for (size_t v = 0; v < nbVariants && g_nbKernels < MAX_KERNELS - NB_WRAPPERS; v++) {
+        BMK_kernel_t* kernel = NULL;
+        for (size_t k = 0; k < g_nbKernels && !kernel; k++)
+            if (!strcmp(g_kernels[k].name, variants[v].name)) kernel = &g_kernels[k];
+        if (kernel) {
+            if (variants[v].isa < kernel->isa) kernel->isa = variants[v].isa, kernel->func = variants[v].kernel;
+            continue;
+        }
+        kernel = &g_kernels[g_nbKernels++];
+        kernel->name = variants[v].name;
+        kernel->isa = variants[v].isa;
+        kernel->func = variants[v].kernel;
+        kernel->func16 = NULL;
+        kernel->id = 0;
+        kernel->props = BMK_DEFAULT | BMK_VERIFY;
+        for (size_t f = 0; f < NB_FAMILYIDS; f++) {
+            if (strcmp(g_familyIds[f].name, kernel->name)) continue;
+            kernel->id = g_familyIds[f].id;
+            kernel->props = g_familyIds[f].props;
+        }
+        if (!kernel->id) kernel->id = nextId++;
     }
+    for (size_t w = 0; w < NB_WRAPPERS; w++) g_kernels[g_nbKernels++] = g_wrappers[w];
+    qsort(g_kernels, g_nbKernels, sizeof(*g_kernels), BMK_compareKernelId);
+}
 
-    IACA_END;
-
-    remainder += 8;  // loaded to registers but unused
-    endSrc -= 8;
-
-    DEBUG_PRINT("|");
-    for (size_t i = 0; i < remainder; i++) {
-        uint64_t byte = endSrc[i];
-        DEBUG_PRINT("%ld ", byte * 4);
-        count[0][byte]++;
-    }
-    DEBUG_PRINT("\n");
+// Best variant of the kernel this CPU runs: 1 if found, 0 if it can't run it
+static int BMK_selectKernel(const BMK_kernel_t* kernel, HIST_kernel_t* func)
+{
+    if (!HIST_isaSupported(kernel->isa)) return 0;
+    if (kernel->func16) g_kernel16 = HIST_bestVariant16(kernel->func16);
+    *func = HIST_bestVariant(kernel->func);
+    return *func != NULL;
+}
 
-    // sum 256 byte counters in 16 separate arrays into count[0][byte]
-    for (int i = 0; i < 256; i++) {
-        for (int idx=1; idx < 16; idx++) {
-            count[0][i] += count[idx][i];
+// selector is -b: a comma separated list of ids and name patterns (glob),
+// empty for every kernel.  Id 0 stands for the default set.
+static int BMK_isSelected(const BMK_kernel_t* kernel, const char* selector, U32 props)
+{
+    if ((kernel->props & props) != props) return 0;
+    if (!*selector) return 1;
+    while (*selector) {
+        char token[64];
+        size_t length = strcspn(selector, ",");
+        snprintf(token, sizeof(token), "%.*s", (int)length, selector);
+        selector += length + (selector[length] == ',');
+        if (token[0] >= '0' && token[0] <= '9') {
+            U32 id = (U32)atoi(token);
+            if (id == kernel->id || (id == 0 && (kernel->props & BMK_DEFAULT))) return 1;
+        } else if (!fnmatch(token, kernel->name, 0)) {
+            return 1;
         }
-        DEBUG_PRINT("%d ", count[0][i]);
     }
-    DEBUG_PRINT("\n");
-
-    free(buffer);
-
-    return count[0][0];
+    return 0;
 }
 
-
-
-// increment a Haswell Port 7 friendly address [constOffset + byte * 4]
-// trying to arrange order to more stores actually happen on Port 7
-#define ASM_INC_GLOBAL_OFFSET_MULTIPLE_BYTES(global, byte0, byte1, byte2, byte3, \
-                                             tmp32_0, tmp32_1, tmp32_2, tmp32_3, \
-                                             offset0, offset1, offset2, offset3) \
-    __asm volatile (                                                    \
-                    "shl $2, %0\n"      /* byte0 *= 2 */                 \
-                    "shl $2, %1\n"      /* byte1 *= 2 */                 \
-                    "shl $2, %2\n"      /* byte2 *= 2 */                 \
-                    "shl $2, %3\n"      /* byte3 *= 2 */                 \
-                    "movl " #global "+%c8(%0), %4\n"                    \
-                    "movl " #global "+%c9(%1), %5\n"                   \
-                    "movl " #global "+%c10(%2), %6\n"                   \
-                    "movl " #global "+%c11(%3), %7\n"                   \
-                    "incl %4\n"                                         \
-                    "incl %5\n"                                         \
-                    "incl %6\n"                                         \
-                    "incl %7\n"                                         \
-                    "movl %4, " #global "+%c8(%0)\n"                    \
-                    "movl %5, " #global "+%c9(%1)\n"                   \
-                    "movl %6, " #global "+%c10(%2)\n"                   \
-                    "movl %7, " #global "+%c11(%3)\n":                  \
-                    "+r" (byte0),  /* read and write */                 \
-                    "+r" (byte1),  /* read and write */                 \
-                    "+r" (byte2),  /* read and write */                 \
-                    "+r" (byte3),  /* read and write */                 \
-                    "=r" (tmp32_0),                                     \
-                    "=r" (tmp32_1),                                     \
-                    "=r" (tmp32_2),                                     \
-                    "=r" (tmp32_3):                                     \
-                    "i" (offset0),                                      \
-                    "i" (offset1),                                      \
-                    "i" (offset2),                                      \
-                    "i" (offset3):                                      \
-                    "memory" /* clobbers */                             \
-                                                                        )
-
-static U32 g_count[16][COUNT_SIZE];
-
-int storePort7(uint8_t *src, size_t srcSize)
+// --list
+static int BMK_listKernels(void)
 {
-    size_t remainder = srcSize; // initially only
-    memset(g_count, 0, sizeof(g_count));
-    if (srcSize < 32) {  // or some small number
-        goto handle_remainder;
+    BMK_DISPLAY("  id name                   variant   runs\n");
+    for (size_t k = 0; k < NB_KERNELS; k++) {
+        HIST_kernel_t func;
+        const char* variant = "-";
+        if (BMK_selectKernel(&g_kernels[k], &func)) {
+            variant = BMK_kernelIsa(func);
+            if (!*variant) variant = "wrapper";
+        }
+        BMK_DISPLAY("%4u %-22s %-9s %s%s%s%s\n", g_kernels[k].id, g_kernels[k].name, variant,
+                    g_kernels[k].props & BMK_DEFAULT ? "default " : "",
+                    g_kernels[k].props & BMK_VERIFY ? "verify " : "",
+                    g_kernels[k].props & BMK_BOUNDED ? "bounded " : "",
+                    g_kernels[k].func16 ? "16-bit" : "");
     }
+    return 0;
+}
 
-    // preload for first loop iteration
-    uint64_t byte0, byte1, byte2, byte3;
-    uint64_t byte4 = *(src + 0);
-    uint64_t byte5 = *(src + 1);
-    uint64_t byte6 = *(src + 2);
-    uint64_t byte7 = *(src + 3);
-    src += 4;
-    srcSize -= 4;
-
-    remainder = srcSize % 16;
-    remainder += 16;  // allow for some safe read-ahead
-    srcSize = srcSize - remainder;
-    uint8_t *endSrc = src + srcSize;
-
-    IACA_START;
-    while (src < endSrc) {
-        uint32_t tmp32_0, tmp32_1, tmp32_2, tmp32_3;
-        
-        byte0 = *(src + 0);
-        byte1 = *(src + 1);
-        byte2 = *(src + 2);
-        byte3 = *(src + 3);
-
-        ASM_INC_GLOBAL_OFFSET_MULTIPLE_BYTES(g_count, byte4, byte5, byte6, byte7, 
-                                             tmp32_0, tmp32_1, tmp32_2, tmp32_3,
-                                             COUNT_SIZE * 4 * 0, COUNT_SIZE * 4 * 1, 
-                                             COUNT_SIZE * 4 * 2, COUNT_SIZE * 4 * 3);
-        byte4 = *(src + 4);
-        byte5 = *(src + 5);
-        byte6 = *(src + 6);
-        byte7 = *(src + 7);
-        ASM_INC_GLOBAL_OFFSET_MULTIPLE_BYTES(g_count, byte0, byte1, byte2, byte3, 
-                                             tmp32_0, tmp32_1, tmp32_2, tmp32_3,
-                                             COUNT_SIZE * 4 * 4, COUNT_SIZE * 4 * 5, 
-                                             COUNT_SIZE * 4 * 6, COUNT_SIZE * 4 * 7);
-
-        byte0 = *(src + 8);
-        byte1 = *(src + 9);
-        byte2 = *(src + 10);
-        byte3 = *(src + 11);
-        ASM_INC_GLOBAL_OFFSET_MULTIPLE_BYTES(g_count, byte4, byte5, byte6, byte7, 
-                                             tmp32_0, tmp32_1, tmp32_2, tmp32_3,
-                                             COUNT_SIZE * 4 * 8, COUNT_SIZE * 4 * 9, 
-                                             COUNT_SIZE * 4 * 10, COUNT_SIZE * 4 * 11);
-        byte4 = *(src + 12);
-        byte5 = *(src + 13);
-        byte6 = *(src + 14);
-        byte7 = *(src + 15);
-        ASM_INC_GLOBAL_OFFSET_MULTIPLE_BYTES(g_count, byte0, byte1, byte2, byte3, 
-                                             tmp32_0, tmp32_1, tmp32_2, tmp32_3,
-                                             COUNT_SIZE * 4 * 12, COUNT_SIZE * 4 * 13, 
-                                             COUNT_SIZE * 4 * 14, COUNT_SIZE * 4 * 15);
-
-
-        src += 16;
-        IACA_END;
+// -L: one flush (widening a slice's 32-bit result into the 64-bit totals)
+// happens every HIST_FLUSH_SIZE bytes, far more than any benchmark block,
+// so time it directly: HIST_count64 against the bare kernel on a small
+// block, best of FLUSH_LOOPS, the difference per call.  ns per flush.
+static double BMK_flushCost(HIST_kernel_t func, const BYTE* src, size_t srcSize)
+{
+    U32 count[HIST_SYMBOLS];
+    U64 count64[HIST_SYMBOLS];
+    double bestKernel = 1e30, bestWide = 1e30;
+
+    if (srcSize > FLUSH_BLOCKSIZE) srcSize = FLUSH_BLOCKSIZE;
+    for (U32 loop = 0; loop < FLUSH_LOOPS; loop++) {
+        U64 startNs = BMK_clockNs();
+        for (U32 n = 0; n < FLUSH_CALLS; n++) func(src, srcSize, count);
+        double kernelNs = (double)(BMK_clockNs() - startNs) / FLUSH_CALLS;
+        startNs = BMK_clockNs();
+        for (U32 n = 0; n < FLUSH_CALLS; n++) HIST_count64(func, src, srcSize, count64);
+        double wideNs = (double)(BMK_clockNs() - startNs) / FLUSH_CALLS;
+        if (kernelNs < bestKernel) bestKernel = kernelNs;
+        if (wideNs < bestWide) bestWide = wideNs;
     }
+    return bestWide > bestKernel ? bestWide - bestKernel : 0;
+}
 
+static void BMK_formatSize(char* out, size_t size)
+{
+    if (size >= (1 GB) && !(size % (1 GB))) sprintf(out, "%uG", (U32)(size >> 30));
+    else if (size >= (1 MB) && !(size % (1 MB))) sprintf(out, "%uM", (U32)(size >> 20));
+    else if (size >= (1 KB) && !(size % (1 KB))) sprintf(out, "%uK", (U32)(size >> 10));
+    else sprintf(out, "%u", (U32)size);
+}
 
-    src -= 4; // redo last four that preloaded
-    remainder += 4;
+int fullSpeedBench(const DG_spec_t* spec, U32 nbBenchs, const BMK_kernel_t* kernel, U32 nbThreads, U32 longCounters)
+{
+    const char* funcName = kernel->name;
+    U32 algNb = kernel->id;
+    HIST_kernel_t func;
 
- handle_remainder:
-    for (size_t i = 0; i < remainder; i++) {
-        uint64_t byte = src[i];
-        g_count[0][byte]++;
+    if (!BMK_selectKernel(kernel, &func)) {
+        BMK_DISPLAY("%4d %-24.24s : not supported on this CPU\n", algNb, funcName);
+        return 0;
     }
 
-    // sum 256 byte counters in 16 separate arrays into count[0][byte]
-    for (int i = 0; i < 256; i++) {
-        for (int idx=1; idx < 16; idx++) {
-            g_count[0][i] += g_count[idx][i];
+    // 16-bit kernels write a global table: no -T or -L for them
+    U32 symbols16 = (kernel->func16 != NULL);
+    if (symbols16) nbThreads = 1, longCounters = 0;
+
+    // any -T, -T1 included, takes the large block: a -T1..-T8 series then
+    // streams from memory at every step, not from L2 at the first one
+    size_t benchedSize = g_blockSize ? g_blockSize :
+                         ((g_threadsSet && !symbols16) || longCounters) ? DEFAULT_LARGE_BLOCKSIZE : 
+                         symbols16 ? DEFAULT_BLOCKSIZE16 : DEFAULT_BLOCKSIZE;
+    if (g_fileData && benchedSize > g_fileSize) benchedSize = g_fileSize;
+    // keep the bytes processed per loop roughly constant across block sizes
+    U32 nbIterations = (U32)((U64)ITERATIONS * DEFAULT_BLOCKSIZE / benchedSize);
+    if (nbIterations == 0) nbIterations = 1;
+    // and go through a whole file in each loop (the tail short of a block is left out)
+    if (g_fileData && nbIterations < g_fileSize / benchedSize) nbIterations = (U32)(g_fileSize / benchedSize);
+
+    const void* input = g_fileData;
+    size_t inputSize = g_fileSize;
+    if (!g_fileData) {
+        if (symbols16 && spec->dist != DG_GEOMETRIC) {
+            BMK_DISPLAY("%4d %-24.24s : 16-bit symbols only come from the geometric curve\n", algNb, funcName);
+            return 0;
         }
+        input = BMK_getData(spec, benchedSize, symbols16 ? g_symbolBits : 0);
+        inputSize = benchedSize;
     }
 
-    return g_count[0][0];
-}
-
-#define ASM_INC_GLOBAL_OFFSET_MULTIPLE_BYTES_RELOAD(global, src, srcOffset, \
-                                                    byte0, byte1, byte2, byte3, \
-                                                    tmp32_0, tmp32_1, tmp32_2, tmp32_3, \
-                                                    offset0, offset1, offset2, offset3) \
-    __asm volatile (                                                    \
-                    "shl $2, %0\n"      /* byte0 *= 2 */                \
-                    "shl $2, %1\n"      /* byte1 *= 2 */                \
-                    "shl $2, %2\n"      /* byte2 *= 2 */                \
-                    "shl $2, %3\n"      /* byte3 *= 2 */                \
-                    "movl " #global "+%c8(%0), %4\n"                    \
-                    "movl " #global "+%c9(%1), %5\n"                    \
-                    "movl " #global "+%c10(%2), %6\n"                   \
-                    "movl " #global "+%c11(%3), %7\n"                   \
-                    "incl %4\n"                                         \
-                    "incl %5\n"                                         \
-                    "incl %6\n"                                         \
-                    "incl %7\n"                                         \
-                    "movl %4, " #global "+%c8(%0)\n"                    \
-                    "movzbl %c13+0(%12), %k0\n"                         \
-                    "movl %5, " #global "+%c9(%1)\n"                    \
-                    "movzbl %c13+1(%12), %k1\n"                         \
-                    "movl %6, " #global "+%c10(%2)\n"                   \
-                    "movzbl %c13+2(%12), %k2\n"                         \
-                    "movl %7, " #global "+%c11(%3)\n"                   \
-                    "movzbl %c13+3(%12), %k3\n" :                       \
-                    "+r" (byte0),  /* read and write */                 \
-                    "+r" (byte1),  /* read and write */                 \
-                    "+r" (byte2),  /* read and write */                 \
-                    "+r" (byte3),  /* read and write */                 \
-                    "=r" (tmp32_0),                                     \
-                    "=r" (tmp32_1),                                     \
-                    "=r" (tmp32_2),                                     \
-                    "=r" (tmp32_3):                                     \
-                    "i" (offset0),                                      \
-                    "i" (offset1),                                      \
-                    "i" (offset2),                                      \
-                    "i" (offset3),                                      \
-                    "r" (src),                                          \
-                    "i" (srcOffset):                                    \
-                    "memory" /* clobbers */                             \
-                                                                        )
-
-
-int reloadPort7(uint8_t *src, size_t srcSize)
-{
-    size_t remainder = srcSize; // initially only
-    memset(g_count, 0, sizeof(g_count));
-    if (srcSize < 32) {  // or some small number
-        goto handle_remainder;
+    // Bench
+    BMK_DISPLAY("\r%79s\r", "");
+    {
+        double bestTime = 999.;
+        double bestTime64 = 999.;
+        double bestCycles = 0;
+        U32 benchNb=1;
+        int errorCode = 0;
+        g_nbSamples = 0;
+        BMK_perfReset();
+        BMK_DISPLAY("%1u-%-22.22s : \r", benchNb, funcName);
+        for (benchNb=1; benchNb <= nbBenchs; benchNb++)
+            {
+                BMK_perfStart();
+                double averageTime = BMK_timeLoop(funcName, func, input, inputSize, benchedSize,
+                                                  nbThreads, 0, nbIterations, &errorCode);
+                BMK_perfStop();
+                if (averageTime < bestTime) bestTime = averageTime, bestCycles = g_cyclesPerCall;
+
+                // 64-bit totals run right after the 32-bit one so both see the same conditions
+                if (longCounters) {
+                    averageTime = BMK_timeLoop(funcName, func, input, inputSize, benchedSize,
+                                               nbThreads, 1, nbIterations, &errorCode);
+                    if (averageTime < bestTime64) bestTime64 = averageTime;
+                }
+                BMK_DISPLAY("%1u-%-22.22s : %8.1f MB/s\r", benchNb+1, funcName, (double)benchedSize / bestTime / 1000.);
+            }
+        BMK_DISPLAY("%4d %-24.24s : %8.1f MB/s   (%i)", algNb, funcName, 
+                (double)benchedSize / bestTime / 1000., (int)errorCode);
+        double minNs, medianNs, p99Ns, cv;
+        BMK_sampleStats(&minNs, &medianNs, &p99Ns, &cv);
+        BMK_DISPLAY("  %6.3f c/B %9.1f ns/call  min %.1f med %.1f p99 %.1f  cv %.2f%%",
+                    bestCycles / benchedSize, bestTime * 1e6, minNs, medianNs, p99Ns, cv * 100);
+        BMK_perfDisplay((double)benchedSize * nbIterations * nbBenchs);
+        char sizeName[16];
+        BMK_formatSize(sizeName, benchedSize);
+        BMK_DISPLAY("  %s blocks", sizeName);
+        if (g_threadsSet || nbThreads > 1) BMK_DISPLAY("  %u thread%s", nbThreads, nbThreads > 1 ? "s" : "");
+        if (longCounters) {
+            // bestTime is in ms per benchedSize bytes
+            double flushNs = BMK_flushCost(func, (const BYTE*)input, inputSize);
+            double sliceNs = bestTime * 1e6 * ((double)HIST_FLUSH_SIZE / benchedSize);
+            BMK_DISPLAY("  64-bit totals %8.1f MB/s (flush %.0f ns per %u MB, %.2g%%)",
+                        (double)benchedSize / bestTime64 / 1000., flushNs,
+                        (U32)(HIST_FLUSH_SIZE >> 20), flushNs * 100. / sliceNs);
+        }
+        BMK_DISPLAY("\n");
+
+        BMK_result_t result = { funcName, algNb, BMK_kernelIsa(func), benchedSize, BMK_inputName(spec),
+                                g_fileData ? 0 : spec->seed, g_inputEntropy,
+                                nbThreads, nbIterations, nbBenchs, bestTime * 1e6,
+                                bestCycles / benchedSize, minNs, medianNs, p99Ns, cv,
+                                errorCode, longCounters ? bestTime64 * 1e6 : 0 };
+        BMK_emitResult(&result);
     }
 
-    // preload for first loop iteration
-    uint64_t byte0 = *(src + 0);
-    uint64_t byte1 = *(src + 1);
-    uint64_t byte2 = *(src + 2);
-    uint64_t byte3 = *(src + 3);
-    uint64_t byte4 = *(src + 4);
-    uint64_t byte5 = *(src + 5);
-    uint64_t byte6 = *(src + 6);
-    uint64_t byte7 = *(src + 7);
-    src += 8;
-    srcSize -= 8;
-
-    remainder = srcSize % 16;
-    remainder += 16;  // allow for some safe read-ahead
-    srcSize = srcSize - remainder;
-    uint8_t *endSrc = src + srcSize;
-
-    IACA_START;
-    while (src < endSrc) {
-        uint32_t tmp32_0, tmp32_1, tmp32_2, tmp32_3;
-        
-        ASM_INC_GLOBAL_OFFSET_MULTIPLE_BYTES_RELOAD(g_count, src, 0, byte0, byte1, byte2, byte3, 
-                                                    tmp32_0, tmp32_1, tmp32_2, tmp32_3,
-                                                    COUNT_SIZE * 4 * 0, COUNT_SIZE * 4 * 1, 
-                                                    COUNT_SIZE * 4 * 2, COUNT_SIZE * 4 * 3);
-
-        ASM_INC_GLOBAL_OFFSET_MULTIPLE_BYTES_RELOAD(g_count, src, 4, byte4, byte5, byte6, byte7, 
-                                                    tmp32_0, tmp32_1, tmp32_2, tmp32_3,
-                                                    COUNT_SIZE * 4 * 4, COUNT_SIZE * 4 * 5, 
-                                                    COUNT_SIZE * 4 * 6, COUNT_SIZE * 4 * 7);
-
-        ASM_INC_GLOBAL_OFFSET_MULTIPLE_BYTES_RELOAD(g_count, src, 8, byte0, byte1, byte2, byte3, 
-                                                    tmp32_0, tmp32_1, tmp32_2, tmp32_3,
-                                                    COUNT_SIZE * 4 * 8, COUNT_SIZE * 4 * 9, 
-                                                    COUNT_SIZE * 4 * 10, COUNT_SIZE * 4 * 11);
-        
-        ASM_INC_GLOBAL_OFFSET_MULTIPLE_BYTES_RELOAD(g_count, src, 12, byte4, byte5, byte6, byte7, 
-                                                    tmp32_0, tmp32_1, tmp32_2, tmp32_3,
-                                                    COUNT_SIZE * 4 * 12, COUNT_SIZE * 4 * 13, 
-                                                    COUNT_SIZE * 4 * 14, COUNT_SIZE * 4 * 15);
-
-
-        src += 16;
-        IACA_END;
+    return 0;
+}
 
-    }
 
+static sigjmp_buf g_guardJump;
 
-    src -= 8; // redo last four that preloaded
-    remainder += 8;
+static void BMK_guardHandler(int sig)
+{
+    (void)sig;
+    siglongjmp(g_guardJump, 1);
+}
 
- handle_remainder:
-    for (size_t i = 0; i < remainder; i++) {
-        uint64_t byte = src[i];
-        g_count[0][byte]++;
+// Run the selected kernels on every input size up to GUARD_MAXSIZE with the
+// input ending exactly at a PROT_NONE page, so that any read past the end
+// faults.  Faults are caught and reported; results must match trivialCount.
+static int BMK_guardTest(const DG_spec_t* spec, const char* selector)
+{
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t dataSize = (GUARD_MAXSIZE + pageSize - 1) / pageSize * pageSize;
+    BYTE* region = mmap(NULL, dataSize + pageSize, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        BMK_DISPLAY("Guard test : cannot map buffer\n");
+        return 1;
     }
-
-    // sum 256 byte counters in 16 separate arrays into count[0][byte]
-    for (int i = 0; i < 256; i++) {
-        for (int idx=1; idx < 16; idx++) {
-            g_count[0][i] += g_count[idx][i];
+    BYTE* guard = region + dataSize;
+    mprotect(guard, pageSize, PROT_NONE);
+    DG_generate(region, dataSize, spec);
+
+    struct sigaction action, oldSegv, oldBus;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = BMK_guardHandler;
+    sigaction(SIGSEGV, &action, &oldSegv);
+    sigaction(SIGBUS, &action, &oldBus);
+
+    int nbFailed = 0;
+    for (size_t k = 0; k < NB_KERNELS; k++) {
+        const BMK_kernel_t* kernel = &g_kernels[k];
+        U32 count[HIST_SYMBOLS], reference[HIST_SYMBOLS];
+        HIST_kernel_t func;
+        volatile size_t size;  // survives the siglongjmp()
+        const char* failure = NULL;
+
+        if (!BMK_isSelected(kernel, selector, BMK_VERIFY) || !BMK_selectKernel(kernel, &func)) continue;
+        for (size = 0; size <= GUARD_MAXSIZE; size++) {
+            const BYTE* src = guard - size;
+            if (sigsetjmp(g_guardJump, 1)) {
+                failure = "read past end";
+                break;
+            }
+            func(src, size, count);
+            if (kernel->func16) {
+                static U32 reference16[1 << HIST_MAX_SYMBOL_BITS];
+                BMK_reference16((const U16 *)src, size / 2, reference16, g_symbolBits);
+                if (memcmp(g_count16, reference16, ((size_t)1 << g_symbolBits) * sizeof(*g_count16))) {
+                    failure = "wrong histogram";
+                    break;
+                }
+                continue;
+            }
+            trivialCount(src, size, reference);
+            if (memcmp(count, reference, sizeof(count))) {
+                failure = "wrong histogram";
+                break;
+            }
+        }
+        if (failure) {
+            BMK_DISPLAY("%4u %-24.24s : %s at %u bytes\n", kernel->id, kernel->name, failure, (U32)size);
+            nbFailed++;
+        } else {
+            BMK_DISPLAY("%4u %-24.24s : OK (0-%u bytes against guard page)\n", kernel->id, kernel->name, GUARD_MAXSIZE);
         }
     }
 
-    return g_count[0][0];
-}
-
-#define ASM_INC_OFFSET_BASE_BYTE_MULTIPLE_RELOAD(offset0, offset1, offset2, offset3, \
-                                                 base, byte0, byte1, byte2, byte3, \
-                                                 src, srcOffset)        \
-    __asm volatile (                                                    \
-                    "shl $2, %0\n"                                      \
-                    "incl %c8+%c4(%0)\n"                        \
-                    "movzbl %c10+0(%9), %k0\n"                          \
-                    "shl $2, %1\n"                                      \
-                    "incl %c8+%c5(%1)\n"                        \
-                    "movzbl %c10+1(%9), %k1\n"                         \
-                    "shl $2, %2\n"                                      \
-                    "incl %c8+%c6(%2)\n"                        \
-                    "movzbl %c10+2(%9), %k2\n"                         \
-                    "shl $2, %3\n"                                      \
-                    "incl %c8+%c7(%3)\n"                        \
-                    "movzbl %c10+3(%9), %k3\n":                        \
-                    "+&r" (byte0),  /* read and write */                 \
-                    "+&r" (byte1),  /* read and write */                 \
-                    "+&r" (byte2),  /* read and write */                 \
-                    "+&r" (byte3):  /* read and write */                \
-                    "i" (offset0),                                      \
-                    "i" (offset1),                                      \
-                    "i" (offset2),                                      \
-                    "i" (offset3),                                      \
-                    "p" (base),                                         \
-                    "r" (src),                                          \
-                    "i" (srcOffset):                                    \
-                    "memory" /* clobbers */                             \
-                                                                        )
-
-int count8reload(uint8_t *src, size_t srcSize)
-{
-    static U32 count[16][COUNT_SIZE];
-    memset(count, 0, sizeof(count));
+    sigaction(SIGSEGV, &oldSegv, NULL);
+    sigaction(SIGBUS, &oldBus, NULL);
+    munmap(region, dataSize + pageSize);
 
-    size_t remainder = srcSize; // initially only
-    if (srcSize < 32) {  // or some small number
-        goto handle_remainder;
-    }
+    return nbFailed != 0;
+}
 
-    // preload for first loop iteration
-    uint64_t byte0 = *(src + 0);
-    uint64_t byte1 = *(src + 1);
-    uint64_t byte2 = *(src + 2);
-    uint64_t byte3 = *(src + 3);
-    uint64_t byte4 = *(src + 4);
-    uint64_t byte5 = *(src + 5);
-    uint64_t byte6 = *(src + 6);
-    uint64_t byte7 = *(src + 7);
-    src += 8;
-    srcSize -= 8;
-
-    remainder = srcSize % 16;
-    remainder += 16;  // allow for some safe read-ahead
-    srcSize = srcSize - remainder;
-    uint8_t *endSrc = src + srcSize;
-
-    IACA_START;
-    while (src < endSrc) {
-        
-        ASM_INC_OFFSET_BASE_BYTE_MULTIPLE_RELOAD(COUNT_SIZE * 4 * 0, COUNT_SIZE * 4 * 1, 
-                                                 COUNT_SIZE * 4 * 2, COUNT_SIZE * 4 * 3,
-                                                 count, byte0, byte1, byte2, byte3, 
-                                                 src, 0);
-
-        ASM_INC_OFFSET_BASE_BYTE_MULTIPLE_RELOAD(COUNT_SIZE * 4 * 4, COUNT_SIZE * 4 * 5, 
-                                                 COUNT_SIZE * 4 * 6, COUNT_SIZE * 4 * 7,
-                                                 count, byte4, byte5, byte6, byte7, 
-                                                 src, 4);
-
-        ASM_INC_OFFSET_BASE_BYTE_MULTIPLE_RELOAD(COUNT_SIZE * 4 * 8, COUNT_SIZE * 4 * 9, 
-                                                 COUNT_SIZE * 4 * 10, COUNT_SIZE * 4 * 11,
-                                                 count, byte0, byte1, byte2, byte3, 
-                                                 src, 8);
-
-        ASM_INC_OFFSET_BASE_BYTE_MULTIPLE_RELOAD(COUNT_SIZE * 4 * 12, COUNT_SIZE * 4 * 13, 
-                                                 COUNT_SIZE * 4 * 14, COUNT_SIZE * 4 * 15,
-                                                 count, byte4, byte5, byte6, byte7, 
-                                                 src, 12);
-
-
-
-        src += 16;
-        IACA_END;
 
+// --verify: every byte kernel against trivialCount, all 256 bins, on every size
+// up to VERIFY_MAXSMALL and a few odd large ones (block and flush edges of
+// the vertical and sub-counter kernels), several alignments, and inputs
+// chosen for the corner cases of each kernel family.
+static const size_t g_verifySizes[] = { 1031, 2047, 4097, 255*32 + 1, 65535, 65537,
+                                        262147, (1 MB) + 3 };
+static const size_t g_verifyAligns[] = { 0, 1, 2, 3, 4, 5, 6, 7, 15, 31, 63 };
+// constant:255 overflows sub-counters, alternate chains store forwarding
+// on two bins, uniform:13 fits the vertical kernels
+static const char* const g_verifyDists[] = { "geometric:0.2", "uniform", "constant:255", "alternate:1",
+                                             "uniform:13", "runs:150", "zipf:1.5", "text" };
+#define NB_VERIFYSIZES (sizeof(g_verifySizes) / sizeof(*g_verifySizes))
+#define NB_VERIFYALIGNS (sizeof(g_verifyAligns) / sizeof(*g_verifyAligns))
+#define NB_VERIFYDISTS (sizeof(g_verifyDists) / sizeof(*g_verifyDists))
+
+// 16-bit kernels against BMK_reference16, at several symbol widths, on
+// symbol counts up to VERIFY_MAXSMALL16 and then g_verifySizes (past the
+// U16 sub-counter flush of count16_4x16), at a few symbol offsets.
+// p = 1 puts every symbol in one bin.
+static const unsigned g_verifyBits16[] = { 1, 3, 8, 12, 16 };  // 1 and 3: the scalar tails
+static const double g_verifyProbas16[] = { 0.2, 0.9, 1.0 };
+static const size_t g_verifyAligns16[] = { 0, 1, 3 };
+#define NB_VERIFYBITS16 (sizeof(g_verifyBits16) / sizeof(*g_verifyBits16))
+#define NB_VERIFYPROBAS16 (sizeof(g_verifyProbas16) / sizeof(*g_verifyProbas16))
+#define NB_VERIFYALIGNS16 (sizeof(g_verifyAligns16) / sizeof(*g_verifyAligns16))
+
+static void BMK_verify16(const char* selector, BYTE* buffer, U32* nbCases, const char** failure,
+                         char (*failureText)[96])
+{
+    static U32 count[1 << HIST_MAX_SYMBOL_BITS], reference[1 << HIST_MAX_SYMBOL_BITS];
+    const size_t maxSymbols = g_verifySizes[NB_VERIFYSIZES - 1];
+    U16* symbols = (U16*)buffer;  // holds 2 * maxSize bytes
+    const unsigned savedBits = g_symbolBits;
+
+    for (size_t b = 0; b < NB_VERIFYBITS16; b++) {
+        for (size_t p = 0; p < NB_VERIFYPROBAS16; p++) {
+            DG_spec_t spec = { DG_GEOMETRIC, g_verifyProbas16[p], 7 };
+            unsigned symbolBits = g_verifyBits16[b];
+            size_t nbBins = (size_t)1 << symbolBits;
+            DG_generate16(symbols, maxSymbols + VERIFY_MAXALIGN, &spec, symbolBits);
+            g_symbolBits = symbolBits;
+
+            for (size_t a = 0; a < NB_KERNELS; a++) {
+                HIST_kernel_t func;
+                if (failure[a] || !g_kernels[a].func16 || !BMK_isSelected(&g_kernels[a], selector, BMK_VERIFY)
+                    || !BMK_selectKernel(&g_kernels[a], &func)) continue;
+
+                for (size_t s = 0; s <= VERIFY_MAXSMALL16 + NB_VERIFYSIZES && !failure[a]; s++) {
+                    size_t nbSymbols = s <= VERIFY_MAXSMALL16 ? s : g_verifySizes[s - VERIFY_MAXSMALL16 - 1];
+                    for (size_t al = 0; al < NB_VERIFYALIGNS16; al++) {
+                        const U16* src = symbols + g_verifyAligns16[al];
+                        memset(count, 0xAA, nbBins * sizeof(*count));
+                        g_kernel16(src, nbSymbols, count, symbolBits);
+                        BMK_reference16(src, nbSymbols, reference, symbolBits);
+                        nbCases[a]++;
+                        for (size_t bin = 0; bin < nbBins; bin++) {
+                            if (count[bin] == reference[bin]) continue;
+                            snprintf(failureText[a], 96,
+                                     "bin %u is %u instead of %u (%u bits, p %.1f, %u symbols at offset %u)",
+                                     (U32)bin, count[bin], reference[bin], symbolBits, g_verifyProbas16[p],
+                                     (U32)nbSymbols, (U32)g_verifyAligns16[al]);
+                            failure[a] = failureText[a];
+                            break;
+                        }
+                        if (failure[a]) break;
+                    }
+                }
+            }
+        }
     }
+    g_symbolBits = savedBits;
+}
 
-
-    src -= 8; // redo last 8 that were preloaded
-    remainder += 8;
-
- handle_remainder:
-    for (size_t i = 0; i < remainder; i++) {
-        uint64_t byte = src[i];
-        count[0][byte]++;
+static int BMK_verify(const char* selector)
+{
+    const size_t maxSize = g_verifySizes[NB_VERIFYSIZES - 1];
+    BYTE* buffer = malloc(2 * (maxSize + VERIFY_MAXALIGN));  // 16-bit symbols too
+    U32 count[HIST_SYMBOLS], reference[HIST_SYMBOLS];
+    U32 nbCases[MAX_KERNELS] = { 0 };
+    const char* failure[MAX_KERNELS] = { NULL };
+    char failureText[MAX_KERNELS][96];
+    int nbFailed = 0;
+
+    if (!buffer) { BMK_DISPLAY("Not enough memory for %u MB\n", (U32)(maxSize >> 20)); return 1; }
+
+    for (U32 dist = 0; dist < NB_VERIFYDISTS; dist++) {
+        DG_spec_t spec = { DG_GEOMETRIC, 0, 7 };
+        DG_parseSpec(g_verifyDists[dist], &spec);
+        DG_generate(buffer, maxSize + VERIFY_MAXALIGN, &spec);
+        unsigned maxByte = 0;
+        for (size_t i = 0; i < maxSize + VERIFY_MAXALIGN; i++) if (buffer[i] > maxByte) maxByte = buffer[i];
+        g_maxSymbol = maxByte;  // a right hint for -b18, -b32 and -b33
+
+        for (size_t a = 0; a < NB_KERNELS; a++) {
+            HIST_kernel_t func;
+            if (failure[a] || g_kernels[a].func16 || !BMK_isSelected(&g_kernels[a], selector, BMK_VERIFY)
+                || !BMK_selectKernel(&g_kernels[a], &func)) continue;
+            size_t nbBins = g_kernels[a].props & BMK_BOUNDED ? g_maxSymbol + 1 : HIST_SYMBOLS;
+
+            for (size_t s = 0; s <= VERIFY_MAXSMALL + NB_VERIFYSIZES && !failure[a]; s++) {
+                size_t size = s <= VERIFY_MAXSMALL ? s : g_verifySizes[s - VERIFY_MAXSMALL - 1];
+                for (size_t al = 0; al < NB_VERIFYALIGNS; al++) {
+                    // large sizes: a few alignments are enough
+                    if (size > VERIFY_MAXSMALL && al > 1 && al != NB_VERIFYALIGNS - 1) continue;
+                    const BYTE* src = buffer + g_verifyAligns[al];
+                    memset(count, 0xAA, sizeof(count));
+                    func(src, size, count);
+                    trivialCount(src, size, reference);
+                    nbCases[a]++;
+                    for (size_t b = 0; b < nbBins; b++) {
+                        if (count[b] == reference[b]) continue;
+                        snprintf(failureText[a], sizeof(failureText[a]),
+                                 "bin %u is %u instead of %u (%s, %u bytes at offset %u)",
+                                 (U32)b, count[b], reference[b], g_verifyDists[dist],
+                                 (U32)size, (U32)g_verifyAligns[al]);
+                        failure[a] = failureText[a];
+                        break;
+                    }
+                    if (failure[a]) break;
+                }
+            }
+        }
     }
-
-    // sum 256 byte counters in 16 separate arrays into count[0][byte]
-    for (int i = 0; i < 256; i++) {
-        for (int idx=1; idx < 16; idx++) {
-            count[0][i] += count[idx][i];
+    g_maxSymbol = 255;
+    BMK_verify16(selector, buffer, nbCases, failure, failureText);
+
+    BMK_DISPLAY("\n");
+    for (size_t a = 0; a < NB_KERNELS; a++) {
+        const BMK_kernel_t* kernel = &g_kernels[a];
+        HIST_kernel_t func;
+        if (!BMK_isSelected(kernel, selector, BMK_VERIFY)) continue;
+        if (!BMK_selectKernel(kernel, &func)) {
+            BMK_DISPLAY("%4u %-24.24s : not supported on this CPU\n", kernel->id, kernel->name);
+        } else if (failure[a]) {
+            BMK_DISPLAY("%4u %-24.24s : FAILED, %s\n", kernel->id, kernel->name, failure[a]);
+            nbFailed++;
+        } else {
+            BMK_DISPLAY("%4u %-24.24s : OK (%u cases)\n", kernel->id, kernel->name, nbCases[a]);
         }
     }
 
-    return count[0][0];
+    free(buffer);
+    return nbFailed != 0;
 }
 
-#define ASM_SHIFT_RIGHT(reg, bitsToShift)                                \
-    __asm volatile ("shr %1, %0":                                       \
-                    "+r" (reg): /* read and written */                  \
-                    "i" (bitsToShift) /* constant */                    \
-                    )
-
-
-#define ASM_INC_TABLES(src0, src1, byte0, byte1, offset, size, base, scale) \
-    __asm volatile ("movzbl %b2, %k0\n"                /* byte0 = src0 & 0xFF */ \
-                    "movzbl %b3, %k1\n"                /* byte1 = src1 & 0xFF */ \
-                    "incl (%c4+0)*%c5(%6, %0, %c7)\n"  /* count[i+0][byte0]++ */ \
-                    "incl (%c4+1)*%c5(%6, %1, %c7)\n"  /* count[i+1][byte1]++ */ \
-                    "movzbl %h2, %k0\n"                /* byte0 = (src0 & 0xFF00) >> 8 */ \
-                    "movzbl %h3, %k1\n"                /* byte1 = (src1 & 0xFF00) >> 8 */ \
-                    "incl (%c4+2)*%c5(%6, %0, %c7)\n"  /* count[i+2][byte0]++ */ \
-                    "incl (%c4+3)*%c5(%6, %1, %c7)\n": /* count[i+3][byte1]++ */ \
-                    "=&R" (byte0),  /* write only (R == non REX) */     \
-                    "=&R" (byte1):  /* write only (R == non REX) */     \
-                    "Q" (src0),  /* read only (Q == must have rH) */    \
-                    "Q" (src1),  /* read only (Q == must have rH) */    \
-                    "i" (offset), /* constant array offset */           \
-                    "i" (size), /* constant array size     */           \
-                    "r" (base),  /* read only array address */          \
-                    "i" (scale):  /* constant [1,2,4,8] */              \
-                    "memory" /* clobbered (forces compiler to compute sum ) */ \
-                    )
-
-int count2x64(uint8_t *src, size_t srcSize)
+// The 16-table reduction is a fixed cost per kernel call, so time it on its
+// own: next to the old scalar loop, and as a share of a 4 KB block at the
+// speed of count2x64 (which reduces 16 tables).
+static void BMK_displayReduction(void)
 {
-    U64 remainder = srcSize;
-    if (srcSize < 32) goto handle_remainder;
+    static HIST_tables_t tables;
+    static BYTE block[4 KB];
+    U32 count[HIST_SYMBOLS];
+    volatile U32 sink = 0;
+    U64 startNs;
 
-    U32 count[16][COUNT_SIZE];
-    memset(count, 0, sizeof(count));
-    
-    remainder = srcSize % 16;
-    srcSize -= remainder;  
-    const BYTE *endSrc = src + srcSize;
-    U64 next0 = *(U64 *)(src + 0);
-    U64 next1 = *(U64 *)(src + 8);
+    DG_spec_t spec = { DG_GEOMETRIC, 0.2, 1 };
 
-    IACA_START;
+    HIST_tablesInit(&tables);
+    DG_generate(block, sizeof(block), &spec);
+    HIST_countTables(&tables, block, sizeof(block));
 
-    while (src != endSrc)
-    {
-        U64 byte0, byte1;
-        U64 data0 = next0;
-        U64 data1 = next1;
-
-        src += 16;
-        next0 = *(U64 *)(src + 0);
-        next1 = *(U64 *)(src + 8);
+    startNs = BMK_clockNs();
+    for (U32 n = 0; n < REDUCE_CALLS; n++) sink += HIST_reduceTables(&tables, 1, count);
+    double simdTime = (double)(BMK_clockNs() - startNs) / REDUCE_CALLS;
 
-        ASM_INC_TABLES(data0, data1, byte0, byte1, 0, COUNT_SIZE * 4, count, 4);
+    startNs = BMK_clockNs();
+    for (U32 n = 0; n < REDUCE_CALLS; n++) {
+        for (int i = 0; i < 256; i++) {
+            U32 sum = tables.table[0][i];
+            for (int idx=1; idx < 16; idx++) {
+                sum += tables.table[idx][i];
+            }
+            count[i] = sum;
+        }
+        __asm volatile("" : : "r"(count) : "memory");
+        sink += count[0];
+    }
+    double scalarTime = (double)(BMK_clockNs() - startNs) / REDUCE_CALLS;
 
-        ASM_SHIFT_RIGHT(data0, 16);
-        ASM_SHIFT_RIGHT(data1, 16);
-        ASM_INC_TABLES(data0, data1, byte0, byte1, 4, COUNT_SIZE * 4, count, 4);
+    startNs = BMK_clockNs();
+    for (U32 n = 0; n < REDUCE_CALLS / 16; n++) sink += count2x64(block, sizeof(block), count);
+    double blockTime = (double)(BMK_clockNs() - startNs) / (REDUCE_CALLS / 16);
 
-        ASM_SHIFT_RIGHT(data0, 16);
-        ASM_SHIFT_RIGHT(data1, 16);
-        ASM_INC_TABLES(data0, data1, byte0, byte1, 8, COUNT_SIZE * 4, count, 4);
+    BMK_DISPLAY("16-table reduction : %5.1f ns (scalar loop %5.1f ns), %4.1f%% of count2x64 on 4 KB\n",
+                simdTime, scalarTime, simdTime * 100. / blockTime);
+}
 
-        ASM_SHIFT_RIGHT(data0, 16);
-        ASM_SHIFT_RIGHT(data1, 16);
-        ASM_INC_TABLES(data0, data1, byte0, byte1, 12, COUNT_SIZE * 4, count, 4);
-    }
 
-    IACA_END;
 
- handle_remainder:
-    for (size_t i = 0; i < remainder; i++) {
-        uint64_t byte = src[i];
-        count[0][byte]++;
+// Throughput (MB/s) of each kernel at block sizes from SWEEP_MINSIZE to
+// maxSize, x4 per step, so each column sits in a different cache level
+// or in DRAM.  Every cell counts SWEEP_BYTES, in at least one call.
+static int BMK_sweep(const DG_spec_t* spec, U32 nbLoops, const char* selector, U32 nbThreads, size_t maxSize)
+{
+    const BYTE* input = g_fileData;
+    size_t inputSize = g_fileSize;
+    char sizeName[16];
+    int errorCode;
+
+    if (g_fileData) {
+        if (maxSize > g_fileSize) maxSize = g_fileSize;
+    } else {
+        input = BMK_getData(spec, maxSize, 0);
+        inputSize = maxSize;
     }
 
-    for (int i = 0; i < 256; i++) {
-        for (int idx=1; idx < 16; idx++) {
-            count[0][i] += count[idx][i];
+    BMK_DISPLAY("%-24s", "MB/s");
+    for (size_t size = SWEEP_MINSIZE; size <= maxSize; size *= 4) {
+        BMK_formatSize(sizeName, size);
+        BMK_DISPLAY(" %7s", sizeName);
+    }
+    BMK_DISPLAY("\n");
+
+    for (size_t k = 0; k < NB_KERNELS; k++) {
+        const BMK_kernel_t* kernel = &g_kernels[k];
+        const char* funcName = kernel->name;
+        HIST_kernel_t func;
+        if (!BMK_isSelected(kernel, selector, *selector ? 0 : BMK_DEFAULT)) continue;
+        BMK_DISPLAY("%-24.24s", funcName);
+        if (!BMK_selectKernel(kernel, &func)) { BMK_DISPLAY(" not supported on this CPU\n"); continue; }
+
+        for (size_t size = SWEEP_MINSIZE; size <= maxSize; size *= 4) {
+            U32 nbIterations = size < SWEEP_BYTES ? (U32)(SWEEP_BYTES / size) : 1;
+            double bestTime = 100000000.;
+            double bestCycles = 0;
+            g_nbSamples = 0;
+            for (U32 loopNb = 0; loopNb < nbLoops; loopNb++) {
+                double averageTime = BMK_timeLoop(funcName, func, input, inputSize, size, nbThreads, 0,
+                                                  nbIterations, &errorCode);
+                if (averageTime < bestTime) bestTime = averageTime, bestCycles = g_cyclesPerCall;
+            }
+            BMK_DISPLAY(" %7.0f", (double)size / bestTime / 1000.);
+
+            BMK_result_t result = { funcName, kernel->id, BMK_kernelIsa(func), size, BMK_inputName(spec),
+                                    g_fileData ? 0 : spec->seed, g_inputEntropy,
+                                    nbThreads, nbIterations, nbLoops, bestTime * 1e6,
+                                    bestCycles / size, 0, 0, 0, 0, errorCode, 0 };
+            BMK_sampleStats(&result.minNs, &result.medianNs, &result.p99Ns, &result.cv);
+            BMK_emitResult(&result);
         }
+        BMK_DISPLAY("\n");
     }
 
-    return count[0][0];
+    return 0;
 }
 
 
-// hist_X_Y functions from https://github.com/powturbo/turbohist
-
-int hist_4_32(uint8_t *in, size_t inlen) { 
-#define NU 16
-    int i;
-    unsigned bin[COUNT_SIZE]={0};
-    unsigned c0[COUNT_SIZE]={0},c1[COUNT_SIZE]={0},c2[COUNT_SIZE]={0},c3[COUNT_SIZE]={0}; 
-    unsigned char *ip;
-
-    unsigned cp = *(unsigned *)in;
-    for(ip = in; ip != in+(inlen&~(NU-1));) {
-        unsigned c = cp; ip += 4; cp = *(unsigned *)ip;
-        c0[(unsigned char)c      ]++;
-        c1[(unsigned char)(c>>8) ]++;
-        c2[(unsigned char)(c>>16)]++;
-        c3[c>>24                 ]++;
-
-        c = cp; ip += 4; cp = *(unsigned *)ip;
-        c0[(unsigned char)c      ]++;
-        c1[(unsigned char)(c>>8) ]++;
-        c2[(unsigned char)(c>>16)]++;
-        c3[c>>24                 ]++;
-
-        c = cp; ip += 4; cp = *(unsigned *)ip;
-        c0[(unsigned char)c      ]++;
-        c1[(unsigned char)(c>>8) ]++;
-        c2[(unsigned char)(c>>16)]++;
-        c3[c>>24                 ]++;
-
-        c = cp; ip += 4; cp = *(unsigned *)ip;
-        c0[(unsigned char)c      ]++;
-        c1[(unsigned char)(c>>8) ]++;
-        c2[(unsigned char)(c>>16)]++;
-        c3[c>>24                 ]++;
-    }
-    while(ip < in+inlen) c0[*ip++]++; 
-    for(i = 0; i < 256; i++) 
-        bin[i] = c0[i]+c1[i]+c2[i]+c3[i];
+// block sizes and distributions measured by --autotune
+static const size_t g_tuneSizes[] = { 64, 256, 1 KB, 4 KB, 16 KB, 64 KB, 256 KB, 1 MB, 4 MB };
+// skewed to flat geometric curves, plus zipf and text for other shapes
+static const char* const g_tuneDists[] = { "geometric:0.02", "geometric:0.2", "geometric:0.9",
+                                           "zipf:1.0", "text" };
 
-    return bin[0];
-#undef NU
-}
+#define NB_TUNESIZES (sizeof(g_tuneSizes) / sizeof(*g_tuneSizes))
+#define NB_TUNEDISTS (sizeof(g_tuneDists) / sizeof(*g_tuneDists))
 
-int hist_4_64(uint8_t *in, size_t inlen) { 
-    int i;
-    unsigned bin[COUNT_SIZE]={0};
-    unsigned c0[COUNT_SIZE]={0},c1[COUNT_SIZE]={0},c2[COUNT_SIZE]={0},c3[COUNT_SIZE]={0}; 
-    unsigned char *ip;
-
-    unsigned long long cp = *(unsigned long long *)in;
-    for(ip = in; ip != in+(inlen&~(16-1)); ) {    
-        unsigned long long c = cp; ip += 8; cp = *(unsigned long long *)ip; 
-        c0[(unsigned char) c     ]++;
-        c1[(unsigned char)(c>> 8)]++;
-        c2[(unsigned char)(c>>16)]++;
-        c3[(unsigned char)(c>>24)]++;
-        c0[(unsigned char)(c>>32)]++;
-        c1[(unsigned char)(c>>40)]++;
-        c2[(unsigned char)(c>>48)]++;
-        c3[                c>>56 ]++;
-
-        c = cp; ip += 8; cp = *(unsigned long long *)ip; 
-        c0[(unsigned char) c    ]++;
-        c1[(unsigned char)(c>> 8)]++;
-        c2[(unsigned char)(c>>16)]++;
-        c3[(unsigned char)(c>>24)]++;
-        c0[(unsigned char)(c>>32)]++;
-        c1[(unsigned char)(c>>40)]++;
-        c2[(unsigned char)(c>>48)]++;
-        c3[                c>>56 ]++;
+// Time every variant this CPU supports at each block size, best of
+// AUTOTUNE_LOOPS per distribution, summed over the distributions, and
+// write the winners as thresholds to tuningFile.
+// Neighbouring sizes with the same winner share one threshold line.
+static int BMK_autotune(const char* tuningFile)
+{
+    size_t nbVariants;
+    const HIST_variant_t* variants = HIST_variants(&nbVariants);
+    const HIST_variant_t* winner[NB_TUNESIZES];
+    size_t maxSize = g_tuneSizes[NB_TUNESIZES-1];
+    BYTE* buffer = malloc(NB_TUNEDISTS * maxSize);
+    int errorCode;
+
+    if (!buffer) { BMK_DISPLAY("Not enough memory\n"); return 1; }
+    for (size_t d = 0; d < NB_TUNEDISTS; d++) {
+        DG_spec_t spec = { DG_GEOMETRIC, 0, 1 };
+        DG_parseSpec(g_tuneDists[d], &spec);
+        DG_generate(buffer + d * maxSize, maxSize, &spec);
     }
-    while(ip < in+inlen) c0[*ip++]++; 
-    for(i = 0; i < 256; i++) 
-        bin[i] = c0[i]+c1[i]+c2[i]+c3[i];
 
-    return bin[0];
-}
-
-int hist_8_64(uint8_t *in, size_t inlen) { 
-    int i;
-    unsigned bin[COUNT_SIZE]={0};
-    unsigned c0[COUNT_SIZE]={0},c1[COUNT_SIZE]={0},c2[COUNT_SIZE]={0},c3[COUNT_SIZE]={0},c4[COUNT_SIZE]={0},c5[COUNT_SIZE]={0},c6[COUNT_SIZE]={0},c7[COUNT_SIZE]={0}; 
-    unsigned char *ip;
-
-    unsigned long long cp = *(unsigned long long *)in;
-    for(ip = in; ip != in+(inlen&~(16-1)); ) {    
-        unsigned long long c = cp; ip += 8; cp = *(unsigned long long *)ip; 
-        c0[(unsigned char) c     ]++;
-        c1[(unsigned char)(c>>8) ]++;
-        c2[(unsigned char)(c>>16)]++;
-        c3[(unsigned char)(c>>24)]++;
-        c4[(unsigned char)(c>>32)]++;
-        c5[(unsigned char)(c>>40)]++;
-        c6[(unsigned char)(c>>48)]++;
-        c7[c>>56]++;
-
-        c = cp;  ip += 8; cp = *(unsigned long long *)ip; 
-        c0[(unsigned char) c     ]++;
-        c1[(unsigned char)(c>>8) ]++;
-        c2[(unsigned char)(c>>16)]++;
-        c3[(unsigned char)(c>>24)]++;
-        c4[(unsigned char)(c>>32)]++;
-        c5[(unsigned char)(c>>40)]++;
-        c6[(unsigned char)(c>>48)]++;
-        c7[                c>>56]++;
+    for (size_t s = 0; s < NB_TUNESIZES; s++) {
+        size_t blockSize = g_tuneSizes[s];
+        U32 nbIterations = (U32)(AUTOTUNE_BYTES / blockSize);
+        double bestTime = 0;
+
+        winner[s] = NULL;
+        for (size_t v = 0; v < nbVariants; v++) {
+            double time = 0;
+            if (!HIST_isaSupported(variants[v].isa)) continue;
+            BMK_DISPLAY("\r%79s\r%7u bytes : %-16s %-8s", "", (U32)blockSize,
+                        variants[v].name, HIST_isaName(variants[v].isa));
+            for (size_t d = 0; d < NB_TUNEDISTS; d++) {
+                double bestLoop = 0;
+                for (U32 loop = 0; loop < AUTOTUNE_LOOPS; loop++) {
+                    double loopTime = BMK_timeLoop(variants[v].name, variants[v].kernel, buffer + d * maxSize,
+                                                   blockSize, blockSize, 1, 0, nbIterations, &errorCode);
+                    if (!loop || loopTime < bestLoop) bestLoop = loopTime;
+                }
+                time += bestLoop;
+            }
+            if (!winner[s] || time < bestTime) { winner[s] = &variants[v]; bestTime = time; }
+        }
+        BMK_DISPLAY("\r%79s\r%7u bytes : %-16s %-8s %8.1f MB/s\n", "", (U32)blockSize,
+                    winner[s]->name, HIST_isaName(winner[s]->isa),
+                    (double)blockSize * NB_TUNEDISTS / bestTime / 1000.);
     }
-    while(ip < in+inlen) c0[*ip++]++; 
-    for(i = 0; i < 256; i++) 
-        bin[i] = c0[i]+c1[i]+c2[i]+c3[i]+c4[i]+c5[i]+c6[i]+c7[i];
+    free(buffer);
 
-    return bin[0];
+    FILE* f = fopen(tuningFile, "w");
+    if (!f) { BMK_DISPLAY("Cannot write %s\n", tuningFile); return 1; }
+    fprintf(f, "# written by countbench --autotune; load with HIST_TUNING=%s\n", tuningFile);
+    fprintf(f, "# maxBlockSize (0 = any larger) kernel isa\n");
+    for (size_t s = 0; s < NB_TUNESIZES; s++) {
+        if (s+1 < NB_TUNESIZES && winner[s+1] == winner[s]) continue;
+        fprintf(f, "%u %s %s\n", s+1 < NB_TUNESIZES ? (U32)g_tuneSizes[s] : 0,
+                winner[s]->name, HIST_isaName(winner[s]->isa));
+    }
+    fclose(f);
+    BMK_DISPLAY("Tuning written to %s\n", tuningFile);
+    return 0;
 }
 
 
-int hist_4_128(uint8_t *in, size_t inlen) { 
-    int i;
-    unsigned bin[COUNT_SIZE]={0};
-    unsigned c0[COUNT_SIZE]={0},c1[COUNT_SIZE]={0},c2[COUNT_SIZE]={0},c3[COUNT_SIZE]={0}; 
-    unsigned char *ip;
-
-    __m128i vcp = _mm_loadu_si128((__m128i*)in);
-    for(ip = in; ip != in+(inlen&~(16-1)); ) {
-        __m128i vc=vcp; ip += 16; vcp = _mm_loadu_si128((__m128i*)ip);
-        c0[_mm_extract_epi8(vc,  0)]++;
-        c1[_mm_extract_epi8(vc,  1)]++;
-        c2[_mm_extract_epi8(vc,  2)]++;
-        c3[_mm_extract_epi8(vc,  3)]++;
-        c0[_mm_extract_epi8(vc,  4)]++;
-        c1[_mm_extract_epi8(vc,  5)]++;
-        c2[_mm_extract_epi8(vc,  6)]++;
-        c3[_mm_extract_epi8(vc,  7)]++;
-        c0[_mm_extract_epi8(vc,  8)]++;
-        c1[_mm_extract_epi8(vc,  9)]++;
-        c2[_mm_extract_epi8(vc, 10)]++;
-        c3[_mm_extract_epi8(vc, 11)]++;
-        c0[_mm_extract_epi8(vc, 12)]++;
-        c1[_mm_extract_epi8(vc, 13)]++;
-        c2[_mm_extract_epi8(vc, 14)]++;
-        c3[_mm_extract_epi8(vc, 15)]++;
+// Show every compiled kernel variant and which ones this CPU can run
+static int BMK_displayDispatch(void)
+{
+    size_t nbVariants;
+    const HIST_variant_t* variants = HIST_variants(&nbVariants);
+    const HIST_variant_t* selected = HIST_selected();
+
+    BMK_DISPLAY("Kernel variants, best first (* = used by HIST_count) :\n");
+    for (size_t v = 0; v < nbVariants; v++) {
+        BMK_DISPLAY(" %c %-16s %-8s %s\n", &variants[v] == selected ? '*' : ' ',
+                    variants[v].name, HIST_isaName(variants[v].isa),
+                    HIST_isaSupported(variants[v].isa) ? "supported" : "-");
     }
-    while(ip < in+inlen) 
-        c0[*ip++]++; 
-    for(i = 0; i < 256; i++) 
-        bin[i] = c0[i]+c1[i]+c2[i]+c3[i];
-
-    return bin[0];
-}
 
-int hist_8_128(uint8_t *in, size_t inlen) { 
-    int i;
-    unsigned bin[COUNT_SIZE]={0};
-    unsigned c0[COUNT_SIZE]={0},c1[COUNT_SIZE]={0},c2[COUNT_SIZE]={0},c3[COUNT_SIZE]={0},c4[COUNT_SIZE]={0},c5[COUNT_SIZE]={0},c6[COUNT_SIZE]={0},c7[COUNT_SIZE]={0}; 
-    unsigned char *ip;
-
-    __m128i vcp = _mm_loadu_si128((__m128i*)in);
-    for(ip = in; ip != in+(inlen&~(16-1)); ) {
-        __m128i vc=vcp; ip += 16; vcp = _mm_loadu_si128((__m128i*)ip);
-        c0[_mm_extract_epi8(vc,  0)]++;
-        c1[_mm_extract_epi8(vc,  1)]++;
-        c2[_mm_extract_epi8(vc,  2)]++;
-        c3[_mm_extract_epi8(vc,  3)]++;
-        c4[_mm_extract_epi8(vc,  4)]++;
-        c5[_mm_extract_epi8(vc,  5)]++;
-        c6[_mm_extract_epi8(vc,  6)]++;
-        c7[_mm_extract_epi8(vc,  7)]++;
-        c0[_mm_extract_epi8(vc,  8)]++;
-        c1[_mm_extract_epi8(vc,  9)]++;
-        c2[_mm_extract_epi8(vc, 10)]++;
-        c3[_mm_extract_epi8(vc, 11)]++;
-        c4[_mm_extract_epi8(vc, 12)]++;
-        c5[_mm_extract_epi8(vc, 13)]++;
-        c6[_mm_extract_epi8(vc, 14)]++;
-        c7[_mm_extract_epi8(vc, 15)]++;
+    if (getenv("HIST_TUNING")) {
+        BMK_DISPLAY("Tuned by %s :\n", getenv("HIST_TUNING"));
+        for (size_t s = 0; s < NB_TUNESIZES; s++) {
+            const HIST_variant_t* tuned = HIST_tunedVariant(g_tuneSizes[s]);
+            BMK_DISPLAY("   %7u bytes : %-16s %s\n", (U32)g_tuneSizes[s],
+                        tuned->name, HIST_isaName(tuned->isa));
+        }
     }
-    while(ip < in+inlen) c0[*ip++]++; 
-    for(i = 0; i < 256; i++) 
-        bin[i] = c0[i]+c1[i]+c2[i]+c3[i]+c4[i]+c5[i]+c6[i]+c7[i];
-
-    return bin[0];
+    return 0;
 }
 
 
-int fullSpeedBench(double proba, U32 nbBenchs, U32 algNb)
+// Read a size with an optional K, M or G suffix, advancing *argument
+static size_t BMK_readSize(char** argument)
 {
-    size_t benchedSize = DEFAULT_BLOCKSIZE;
-    void* oBuffer = malloc(benchedSize);
-    char* funcName;
-    int (*func)(uint8_t *src, size_t srcSize);
-
-
-    BMK_genData(oBuffer, benchedSize, proba);
-
-    switch (algNb)
-        {
-        case 1:
-            funcName = "trivialCount";
-            func = trivialCount;
-            break;
-
-        case 2:
-            funcName = "count2x64";
-            func = count2x64;
-            break;
-
-        case 3:
-            funcName = "count_vec";
-            func = count_vec;
-            break;
-
-        case 4:
-            funcName = "storePort7";
-            func = storePort7;
-            break;
-
-        case 5:
-            funcName = "reloadPort7";
-            func = storePort7;
-            break;
-
-        case 6:
-            funcName = "count8reload";
-            func = count8reload;
-            break;
-
-        case 7:
-            funcName = "vecavx";
-            func = vecavx;
-            break;
-
-
-        case 10:
-            funcName = "hist_4_128";
-            func = hist_4_128;
-            break;
-
-        case 11:
-            funcName = "hist_8_128";
-            func = hist_8_128;
-            break;
-
-        case 12:
-            funcName = "hist_4_32";
-            func = hist_4_32;
-            break;
-
-        case 13:
-            funcName = "hist_4_64";
-            func = hist_4_64;
-            break;
-
-#ifdef __AVX2__
-        case 20:
-            funcName = "port7vec";
-            func = port7vec;
-            break;
-#endif //__AVX2__
-
-        default:
-            BMK_DISPLAY("Unknown algorithm number\n");
-            exit(-1);
-        }
-
-    // Bench
-    BMK_DISPLAY("\r%79s\r", "");
-    {
-        double bestTime = 999.;
-        U32 benchNb=1;
-        int errorCode = 0;
-        BMK_DISPLAY("%1u-%-22.22s : \r", benchNb, funcName);
-        for (benchNb=1; benchNb <= nbBenchs; benchNb++)
-            {
-                U32 milliTime;
-                double averageTime;
-                U32 loopNb=0;
-
-                milliTime = BMK_GetMilliStart();
-                while(BMK_GetMilliStart() == milliTime);
-                milliTime = BMK_GetMilliStart();
-
-                likwid_markerStartRegion(funcName);
-
-                // fixed number of iterations (instead of fixed time in original)
-                for (int i = 0; i < ITERATIONS; i++) 
-                    {
-                        errorCode = func(oBuffer, benchedSize);
-                        if (errorCode < 0) exit(-1);
-                        loopNb++;
-                    }
-
-                likwid_markerStopRegion(funcName);
-
-                milliTime = BMK_GetMilliSpan(milliTime);
-                averageTime = (double)milliTime / loopNb;
-                if (averageTime < bestTime) bestTime = averageTime;
-                BMK_DISPLAY("%1u-%-22.22s : %8.1f MB/s\r", benchNb+1, funcName, (double)benchedSize / bestTime / 1000.);
-            }
-        BMK_DISPLAY("%4d %-24.24s : %8.1f MB/s   (%i)\n", algNb, funcName, 
-                (double)benchedSize / bestTime / 1000., (int)errorCode);
+    size_t size = 0;
+    while ((**argument >='0') && (**argument <='9')) size*=10, size += *(*argument)++ - '0';
+    switch (**argument) {
+    case 'K': size <<= 10; (*argument)++; break;
+    case 'M': size <<= 20; (*argument)++; break;
+    case 'G': size <<= 30; (*argument)++; break;
     }
-
-    free(oBuffer);
-
-    return 0;
+    return size;
 }
 
-
 int usage(char* exename)
 {
     BMK_DISPLAY( "Usage :\n");
     BMK_DISPLAY( "      %s [arg] \n", exename);
     BMK_DISPLAY( "Arguments :\n");
-    BMK_DISPLAY( " -b#    : select function to benchmark (default : 0 ==  all)\n");
+    BMK_DISPLAY( " -b#    : select functions by id or name pattern, e.g. -b2,hist_* (default : 0 == default set)\n");
+    BMK_DISPLAY( " --list : list functions, their ids and the variant this CPU runs\n");
     BMK_DISPLAY( " -H/-h  : Help (this text + advanced options)\n");
     return 0;
 }
@@ -1509,7 +1449,35 @@ int usage_advanced(char* exename)
     usage(exename);
     BMK_DISPLAY( "\nAdvanced options :\n");
     BMK_DISPLAY( " -i#    : iteration loops [1-9] (default : %i)\n", NBLOOPS);
-    BMK_DISPLAY( " -P#    : probability curve, in %% (default : %i%%)\n", DEFAULT_PROBA);
+    BMK_DISPLAY( " -B#    : block size, with K, M or G suffix (default : %i KB, %i MB with -T/-L)\n", 
+                 DEFAULT_BLOCKSIZE >> 10, DEFAULT_LARGE_BLOCKSIZE >> 20);
+    BMK_DISPLAY( " -P#    : probability curve, in %% (default : %i%%); -P2,20,90 sweeps skew\n", DEFAULT_PROBA);
+    BMK_DISPLAY( " -D...  : distributions name[:param], comma separated (default : geometric, with -P)\n");
+    BMK_DISPLAY( "          geometric:p uniform:n zipf:s runs:length alternate:b constant:b text\n");
+    BMK_DISPLAY( " -S#    : generator seed (default : 1)\n");
+    BMK_DISPLAY( " -E#    : entropy target in bits/byte, sets the parameter of geometric, uniform and zipf\n");
+    BMK_DISPLAY( " -M#    : max symbol for -b18, -b32 and -b33 (default : 255)\n");
+    BMK_DISPLAY( " -K#    : %i KB blocks per HIST_countBatch call for -b34/-b35 (default : %i)\n",
+                 BATCH_BLOCKSIZE >> 10, DEFAULT_BATCH);
+    BMK_DISPLAY( " -W#    : symbol width in bits for the 16-bit kernels -b40..43 (default : %i)\n", HIST_MAX_SYMBOL_BITS);
+    BMK_DISPLAY( " -f file: benchmark on the blocks of file instead of generated data\n");
+    BMK_DISPLAY( " -C#    : chunk size in bytes for HIST_stream (default : %i)\n", DEFAULT_STREAM_CHUNK);
+    BMK_DISPLAY( " -v     : also time the 16-table reduction every t_count kernel ends with\n");
+    BMK_DISPLAY( " -L     : also time 64-bit totals (%i MB input)\n", DEFAULT_LARGE_BLOCKSIZE >> 20);
+    BMK_DISPLAY( " -T#    : worker threads, %i MB input when given (default : %i)\n", 
+                 DEFAULT_LARGE_BLOCKSIZE >> 20, DEFAULT_THREADS);
+    BMK_DISPLAY( " --dispatch : list kernel variants and the one selected for this CPU\n");
+    BMK_DISPLAY( " --sweep[=size] : MB/s matrix, kernels x block sizes %i B to size (default : 1G)\n",
+                 SWEEP_MINSIZE);
+    BMK_DISPLAY( " --format=csv|json : also write one record per kernel run to stdout\n");
+    BMK_DISPLAY( " --hugetlb  : generated input from the explicit huge page pool (else THP)\n");
+    BMK_DISPLAY( " --numa     : bind -T workers to NUMA nodes, first-touch their input chunks\n");
+    BMK_DISPLAY( " --node=#   : bind generated input to this NUMA node (remote memory tests)\n");
+    BMK_DISPLAY( " --perf     : hardware counters per kernel (IPC, uops, L1D misses, machine clears)\n");
+    BMK_DISPLAY( " --verify   : compare every kernel's full histogram with trivialCount\n");
+    BMK_DISPLAY( " --guard    : check kernels on inputs that end at a guard page\n");
+    BMK_DISPLAY( " --autotune[=file] : time all variants per block size, write thresholds\n");
+    BMK_DISPLAY( "              for HIST_count to file (default : %s)\n", DEFAULT_TUNING_FILE);
     return 0;
 }
 
@@ -1523,12 +1491,24 @@ int badusage(char* exename)
 int main(int argc, char** argv)
 {
     char* exename=argv[0];
-    U32 proba = DEFAULT_PROBA;
+    U32 probas[MAX_PROBAS] = { DEFAULT_PROBA };
+    const char* dists = NULL;  // -D
+    U32 seed = 1;
+    double entropyTarget = -1;
+    U32 nbProbas = 1;
     U32 nbLoops = NBLOOPS;
+    U32 nbThreads = DEFAULT_THREADS;
+    U32 longCounters = 0;
+    U32 guardTest = 0;
+    U32 verify = 0;
+    U32 numa = 0;
+    size_t sweepSize = 0;
     U32 pause = 0;
-    U32 algNb = 0;
+    U32 verbose = 0;
+    char selector[256] = "";  // -b
+    const char* fileName = NULL;
     int i;
-    int result;
+    int result = 0;
 
     // Welcome message
     BMK_DISPLAY(WELCOME_MESSAGE);
@@ -1536,6 +1516,8 @@ int main(int argc, char** argv)
 
     likwid_markerInit();
     likwid_markerThreadInit();
+    BMK_readCpuInfo();
+    BMK_buildRegistry();
 
     for(i=1; i<argc; i++)
         {
@@ -1543,6 +1525,26 @@ int main(int argc, char** argv)
 
             if(!argument) continue;   // Protection if argument empty
 
+            if (!strcmp(argument, "--guard")) { guardTest=1; continue; }
+            if (!strcmp(argument, "--verify")) { verify=1; continue; }
+            if (!strcmp(argument, "--list")) return BMK_listKernels();
+            if (!strcmp(argument, "--hugetlb")) { g_allocFlags |= HIST_ALLOC_HUGETLB; continue; }
+            if (!strcmp(argument, "--numa")) { numa=1; continue; }
+            if (!strncmp(argument, "--node=", 7)) { g_allocNode = atoi(argument + 7); continue; }
+            if (!strcmp(argument, "--perf")) { BMK_perfOpen(); continue; }
+            if (!strcmp(argument, "--format=csv")) { g_format = FORMAT_CSV; continue; }
+            if (!strcmp(argument, "--format=json")) { g_format = FORMAT_JSON; continue; }
+            if (!strcmp(argument, "--format=text")) { g_format = FORMAT_TEXT; continue; }
+            if (!strcmp(argument, "--dispatch")) return BMK_displayDispatch();
+            if (!strcmp(argument, "--sweep")) { sweepSize = SWEEP_MAXSIZE; continue; }
+            if (!strncmp(argument, "--sweep=", 8)) {
+                argument += 8;
+                sweepSize = BMK_readSize(&argument);
+                continue;
+            }
+            if (!strcmp(argument, "--autotune")) return BMK_autotune(DEFAULT_TUNING_FILE);
+            if (!strncmp(argument, "--autotune=", 11)) return BMK_autotune(argument + 11);
+
             // Decode command (note : aggregated commands are allowed)
             if (*argument=='-')
                 {
@@ -1560,11 +1562,17 @@ int main(int argc, char** argv)
                                 case 'h' :
                                 case 'H': return usage_advanced(exename);
 
-                                    // Select Algo nb
+                                    // Select kernels: ids and name patterns, comma separated
+                                    // (a pattern takes the rest of the argument)
                                 case 'b':
-                                    argument++;
-                                    algNb=0;
-                                    while ((*argument >='0') && (*argument <='9')) algNb*=10, algNb += *argument++ - '0';
+                                    {
+                                        size_t length;
+                                        argument++;
+                                        length = strspn(argument, "0123456789,");
+                                        if (length == 0 || argument[length-1] == ',') length = strlen(argument);
+                                        snprintf(selector, sizeof(selector), "%.*s", (int)length, argument);
+                                        argument += length;
+                                    }
                                     break;
 
                                     // Modify Nb loops
@@ -1574,11 +1582,101 @@ int main(int argc, char** argv)
                                     while ((*argument >='0') && (*argument <='9')) nbLoops*=10, nbLoops += *argument++ - '0';
                                     break;
 
-                                    // Modify data probability
+                                    // Modify data probability (comma separated list to sweep skew)
                                 case 'P':
+                                    nbProbas=0;
+                                    do {
+                                        argument++;
+                                        U32 proba=0;
+                                        while ((*argument >='0') && (*argument <='9')) proba*=10, proba += *argument++ - '0';
+                                        if (nbProbas < MAX_PROBAS) probas[nbProbas++] = proba;
+                                    } while (*argument == ',');
+                                    break;
+
+                                    // Distributions, comma separated name[:param] list (takes the rest)
+                                case 'D':
+                                    argument++;
+                                    dists = argument;
+                                    argument += strlen(argument);
+                                    break;
+
+                                    // Generator seed
+                                case 'S':
+                                    argument++;
+                                    seed=0;
+                                    while ((*argument >='0') && (*argument <='9')) seed*=10, seed += *argument++ - '0';
+                                    break;
+
+                                    // Entropy target, in bits per byte
+                                case 'E':
+                                    argument++;
+                                    entropyTarget = strtod(argument, &argument);
+                                    break;
+
+                                    // Modify number of worker threads
+                                case 'T':
+                                    argument++;
+                                    g_threadsSet=1;
+                                    nbThreads=0;
+                                    while ((*argument >='0') && (*argument <='9')) nbThreads*=10, nbThreads += *argument++ - '0';
+                                    break;
+
+                                    // Block size
+                                case 'B':
+                                    argument++;
+                                    g_blockSize = BMK_readSize(&argument);
+                                    break;
+
+                                    // Blocks per batch for -b34/-b35
+                                case 'K':
+                                    argument++;
+                                    g_batchSize=0;
+                                    while ((*argument >='0') && (*argument <='9')) g_batchSize*=10, g_batchSize += *argument++ - '0';
+                                    if (g_batchSize < 1 || g_batchSize > MAX_BATCH) g_batchSize = DEFAULT_BATCH;
+                                    break;
+
+                                    // Symbol width of the 16-bit kernels
+                                case 'W':
+                                    argument++;
+                                    g_symbolBits=0;
+                                    while ((*argument >='0') && (*argument <='9')) g_symbolBits*=10, g_symbolBits += *argument++ - '0';
+                                    if (g_symbolBits < 1 || g_symbolBits > HIST_MAX_SYMBOL_BITS) g_symbolBits = HIST_MAX_SYMBOL_BITS;
+                                    break;
+
+                                    // Max symbol hint for count_vertical and HIST_countHint
+                                case 'M':
+                                    argument++;
+                                    g_maxSymbol=0;
+                                    while ((*argument >='0') && (*argument <='9')) g_maxSymbol*=10, g_maxSymbol += *argument++ - '0';
+                                    break;
+
+                                    // Modify stream chunk size
+                                case 'C':
+                                    argument++;
+                                    g_streamChunkSize=0;
+                                    while ((*argument >='0') && (*argument <='9')) g_streamChunkSize*=10, g_streamChunkSize += *argument++ - '0';
+                                    if (!g_streamChunkSize) g_streamChunkSize = DEFAULT_STREAM_CHUNK;
+                                    break;
+
+                                    // Input file instead of generated data
+                                case 'f':
+                                    argument++;
+                                    if (!*argument && i + 1 < argc) argument = argv[++i];
+                                    if (!*argument) return badusage(exename);
+                                    fileName = argument;
+                                    argument += strlen(argument);
+                                    break;
+
+                                    // Time 64-bit totals as well
+                                case 'L':
+                                    longCounters=1;
+                                    argument++;
+                                    break;
+
+                                    // Verbose: also time the 16-table reduction
+                                case 'v':
+                                    verbose=1;
                                     argument++;
-                                    proba=0;
-                                    while ((*argument >='0') && (*argument <='9')) proba*=10, proba += *argument++ - '0';
                                     break;
 
                                     // Pause at the end (hidden option)
@@ -1596,29 +1694,59 @@ int main(int argc, char** argv)
 
         }
 
-    if (algNb==0)
+    if (fileName && BMK_mapFile(fileName)) return 1;
+    if (numa) {
+        HIST_bindWorkers(1);
+        g_touchThreads = nbThreads;
+        BMK_DISPLAY("%i NUMA node(s), input chunks placed by the workers that count them\n", HIST_numaNodes());
+    }
+
+    // Inputs: each -D distribution, a geometric one without a parameter
+    // once per -P value; -E sets the parameter instead
+    DG_spec_t inputs[MAX_INPUTS];
+    U32 nbInputs = 0;
+    do {
+        char spec[64] = "geometric";
+        if (dists) {
+            size_t length = strcspn(dists, ",");
+            snprintf(spec, sizeof(spec), "%.*s", (int)length, dists);
+            dists += length + (dists[length] == ',');
+        }
+        DG_spec_t input = { DG_GEOMETRIC, 0, seed };
+        if (DG_parseSpec(spec, &input)) { BMK_DISPLAY("Unknown distribution %s\n", spec); return 1; }
+        U32 perProba = input.dist == DG_GEOMETRIC && !strchr(spec, ':') && entropyTarget < 0;
+        for (U32 p = 0; p < (perProba ? nbProbas : 1) && nbInputs < MAX_INPUTS; p++) {
+            if (perProba) input.param = (double)probas[p] / 100;
+            if (entropyTarget >= 0 && DG_calibrate(&input, entropyTarget))
+                BMK_DISPLAY("%s has no entropy parameter, -E ignored\n", spec);
+            inputs[nbInputs++] = input;
+        }
+    } while (dists && *dists);
+
+    if (guardTest) return BMK_guardTest(&inputs[0], selector);
+    if (verify) return BMK_verify(selector);
+
+    U32 nbSelected = 0;
+    for (size_t k = 0; k < NB_KERNELS; k++)
+        nbSelected += BMK_isSelected(&g_kernels[k], selector, *selector ? 0 : BMK_DEFAULT);
+    if (!nbSelected) { BMK_DISPLAY("No kernel matches -b%s (see --list)\n", selector); return 1; }
+
+    if (sweepSize)
+        {
+            for (U32 n = 0; n < nbInputs; n++)
+                result = BMK_sweep(&inputs[n], nbLoops, selector, nbThreads, sweepSize);
+            return result;
+        }
+
+    if (verbose) BMK_displayReduction();
+
+    for (U32 n = 0; n < nbInputs; n++)
         {
-            result = fullSpeedBench((double)proba / 100, nbLoops, 1);
-            result = fullSpeedBench((double)proba / 100, nbLoops, 2);
-            result = fullSpeedBench((double)proba / 100, nbLoops, 3);
-            result = fullSpeedBench((double)proba / 100, nbLoops, 4);
-            result = fullSpeedBench((double)proba / 100, nbLoops, 5);
-            result = fullSpeedBench((double)proba / 100, nbLoops, 6);
-#ifdef TESTING
-            result = fullSpeedBench((double)proba / 100, nbLoops, 7);
-#endif
-            result = fullSpeedBench((double)proba / 100, nbLoops, 10);
-            result = fullSpeedBench((double)proba / 100, nbLoops, 11);
-            result = fullSpeedBench((double)proba / 100, nbLoops, 12);
-            result = fullSpeedBench((double)proba / 100, nbLoops, 13);
-
-#ifdef __AVX2__
-            result = fullSpeedBench((double)proba / 100, nbLoops, 20);
-#endif // __AVX2__
+            for (size_t k = 0; k < NB_KERNELS; k++)
+                if (BMK_isSelected(&g_kernels[k], selector, *selector ? 0 : BMK_DEFAULT))
+                    result = fullSpeedBench(&inputs[n], nbLoops, &g_kernels[k], nbThreads, longCounters);
+            if (g_fileData) break;  // the inputs only differ in generated data
         }
-    else {
-        result = fullSpeedBench((double)proba / 100, nbLoops, algNb);
-    }
     if (pause) { BMK_DISPLAY("press enter...\n"); getchar(); }
 
     likwid_markerClose();
@@ -0,0 +1,318 @@
+// Synthetic inputs for countbench, split out of countbench.c.
+// Build it along with the benchmark (see the line at the top of countbench.c).
+
+/*
+  Based on fullbench.c - Demo program to benchmark open-source compression algorithm
+  Copyright (C) Yann Collet 2012-2014  GPL v2 License
+  - public forum : https://groups.google.com/forum/#!forum/lz4c
+  - website : http://fastcompression.blogspot.com/
+*/
+
+#include <stdlib.h>    // atof()
+#include <stdio.h>     // snprintf()
+#include <string.h>    // strncmp()
+#include <math.h>      // log2(), pow()
+
+#include "datagen.h"
+
+typedef uint8_t  BYTE;
+typedef uint16_t U16;
+typedef uint32_t U32;
+
+#define PROBATABLESIZE 2048
+#define PROBATABLESIZE16 (1<<16)
+#define ZIPFTABLESIZE (1<<16)
+#define TEXT_SAMPLE (64<<10)     // bytes measured for the entropy of text
+
+static const struct {
+    const char *name;
+    double defaultParam;
+} g_dists[DG_NB_DISTS] = {
+    [DG_GEOMETRIC] = { "geometric", 0.2 },
+    [DG_UNIFORM]   = { "uniform",   256 },
+    [DG_ZIPF]      = { "zipf",      1.0 },
+    [DG_RUNS]      = { "runs",      16 },
+    [DG_ALTERNATE] = { "alternate", 1 },
+    [DG_CONSTANT]  = { "constant",  0 },
+    [DG_TEXT]      = { "text",      0 },
+};
+
+#define DG_PRIME1   2654435761U
+#define DG_PRIME2   2246822519U
+static U32 DG_rand(U32 *seed)
+{
+    *seed =  ( (*seed) * DG_PRIME1) + DG_PRIME2;
+    return (*seed) >> 11;
+}
+
+int DG_parseSpec(const char *text, DG_spec_t *spec)
+{
+    size_t nameLength = strcspn(text, ":");
+
+    for (int d = 0; d < DG_NB_DISTS; d++) {
+        if (strlen(g_dists[d].name) != nameLength || strncmp(text, g_dists[d].name, nameLength)) continue;
+        spec->dist = (DG_dist_t)d;
+        spec->param = text[nameLength] == ':' ? atof(text + nameLength + 1) : g_dists[d].defaultParam;
+        return 0;
+    }
+    return -1;
+}
+
+const char *DG_distName(DG_dist_t dist)
+{
+    return dist < DG_NB_DISTS ? g_dists[dist].name : "unknown";
+}
+
+void DG_specName(const DG_spec_t *spec, char *out, size_t outSize)
+{
+    switch (spec->dist) {
+    case DG_GEOMETRIC:
+    case DG_ZIPF:
+        snprintf(out, outSize, "%s:%.2f", DG_distName(spec->dist), spec->param);
+        break;
+    case DG_TEXT:
+        snprintf(out, outSize, "%s", DG_distName(spec->dist));
+        break;
+    default:
+        snprintf(out, outSize, "%s:%u", DG_distName(spec->dist), (U32)spec->param);
+        break;
+    }
+}
+
+static double DG_geometricP(double p)
+{
+    if (p<0.01) p = 0.005;
+    if (p>1.) p = 1.;
+    return p;
+}
+
+// Lookup table for the geometric curve: symbol s takes a p share of the
+// entries still free, so the first symbols are the most frequent
+static void DG_geometricTable(BYTE *table, double p)
+{
+    int remaining = PROBATABLESIZE;
+    unsigned pos = 0;
+    unsigned s = 0;
+
+    p = DG_geometricP(p);
+    while (remaining)
+        {
+            unsigned n = (unsigned)(remaining * p);
+            unsigned end;
+            if (!n) n=1;
+            end = pos + n;
+            while (pos<end) table[pos++]=(BYTE)s;
+            s++;
+            remaining -= n;
+        }
+}
+
+// Lookup table for zipf: byte k gets a share proportional to 1/(k+1)^s,
+// rounded so the shares add up to exactly ZIPFTABLESIZE entries
+static void DG_zipfTable(BYTE *table, double s)
+{
+    double weight[256], total = 0, cumulated = 0;
+    size_t pos = 0;
+
+    for (int k = 0; k < 256; k++) total += weight[k] = pow(k + 1, -s);
+    for (int k = 0; k < 256; k++) {
+        cumulated += weight[k];
+        size_t end = (size_t)(cumulated / total * ZIPFTABLESIZE + 0.5);
+        if (k == 255) end = ZIPFTABLESIZE;
+        while (pos < end) table[pos++] = (BYTE)k;
+    }
+}
+
+static double DG_tableEntropy(const BYTE *table, size_t tableSize)
+{
+    size_t count[256] = { 0 };
+    double entropy = 0;
+
+    for (size_t i = 0; i < tableSize; i++) count[table[i]]++;
+    for (int k = 0; k < 256; k++)
+        if (count[k]) entropy -= (double)count[k] / tableSize * log2((double)count[k] / tableSize);
+    return entropy;
+}
+
+// Letters in English text, per thousand
+static const struct { char letter; U32 frequency; } g_letters[] = {
+    { 'e', 127 }, { 't', 91 }, { 'a', 82 }, { 'o', 75 }, { 'i', 70 }, { 'n', 67 }, { 's', 63 },
+    { 'h', 61 }, { 'r', 60 }, { 'd', 43 }, { 'l', 40 }, { 'c', 28 }, { 'u', 28 }, { 'm', 24 },
+    { 'w', 24 }, { 'f', 22 }, { 'g', 20 }, { 'y', 20 }, { 'p', 19 }, { 'b', 15 }, { 'v', 10 },
+    { 'k', 8 }, { 'j', 2 }, { 'x', 2 }, { 'q', 1 }, { 'z', 1 },
+};
+
+// Words of 1 to 10 letters, sentences of 4 to 19 words with the odd comma,
+// a newline after about one sentence in eight
+static void DG_genText(BYTE *op, size_t size, U32 *seed)
+{
+    char letters[1024];
+    size_t nbLetters = 0;
+    const BYTE *oend = op + size;
+    U32 wordsLeft = 0;
+
+    for (size_t l = 0; l < sizeof(g_letters) / sizeof(*g_letters); l++)
+        for (U32 f = 0; f < g_letters[l].frequency && nbLetters < sizeof(letters); f++)
+            letters[nbLetters++] = g_letters[l].letter;
+
+    while (op < oend) {
+        U32 capital = 0;
+        if (!wordsLeft) {
+            wordsLeft = 4 + DG_rand(seed) % 16;
+            capital = 1;
+        }
+        U32 wordLength = 1 + DG_rand(seed) % 10;
+        while (wordLength-- && op < oend) {
+            char letter = letters[DG_rand(seed) % nbLetters];
+            *op++ = (BYTE)(capital ? letter - 'a' + 'A' : letter);
+            capital = 0;
+        }
+        if (--wordsLeft == 0) {
+            if (op < oend) *op++ = '.';
+            if (op < oend) *op++ = DG_rand(seed) % 8 ? ' ' : '\n';
+        } else {
+            if (op < oend && DG_rand(seed) % 12 == 0) *op++ = ',';
+            if (op < oend) *op++ = ' ';
+        }
+    }
+}
+
+void DG_generate(void *buffer, size_t size, const DG_spec_t *spec)
+{
+    static BYTE table[ZIPFTABLESIZE];
+    BYTE *op = (BYTE *)buffer;
+    BYTE *oend = op + size;
+    U32 seed = spec->seed;
+
+    switch (spec->dist) {
+    case DG_GEOMETRIC:
+        DG_geometricTable(table, spec->param);
+        while (op < oend) *op++ = table[DG_rand(&seed) & (PROBATABLESIZE-1)];
+        break;
+    case DG_UNIFORM:
+        {
+            U32 nbSymbols = spec->param < 1 ? 1 : spec->param > 256 ? 256 : (U32)spec->param;
+            while (op < oend) *op++ = (BYTE)(DG_rand(&seed) % nbSymbols);
+        }
+        break;
+    case DG_ZIPF:
+        DG_zipfTable(table, spec->param);
+        while (op < oend) *op++ = table[DG_rand(&seed) & (ZIPFTABLESIZE-1)];
+        break;
+    case DG_RUNS:
+        {
+            U32 meanLength = spec->param < 1 ? 1 : (U32)spec->param;
+            while (op < oend) {
+                size_t runLength = 1 + DG_rand(&seed) % (2 * meanLength - 1);
+                BYTE byte = (BYTE)DG_rand(&seed);
+                if (runLength > (size_t)(oend - op)) runLength = oend - op;
+                memset(op, byte, runLength);
+                op += runLength;
+            }
+        }
+        break;
+    case DG_ALTERNATE:
+        for (size_t i = 0; i < size; i++) op[i] = (BYTE)(i & 1 ? (U32)spec->param : 0);
+        break;
+    case DG_CONSTANT:
+        memset(op, (BYTE)(U32)spec->param, size);
+        break;
+    case DG_TEXT:
+    default:
+        DG_genText(op, size, &seed);
+        break;
+    }
+}
+
+void DG_generate16(U16 *buffer, size_t nbSymbols, const DG_spec_t *spec, unsigned symbolBits)
+{
+    static U16 table[PROBATABLESIZE16];
+    int remaining = PROBATABLESIZE16;
+    unsigned pos = 0;
+    unsigned s = 0;
+    const unsigned mask = (1U << symbolBits) - 1;
+    const double p = DG_geometricP(spec->param);
+    U32 seed = spec->seed;
+
+    while (remaining)
+        {
+            unsigned n = (unsigned)(remaining * p);
+            unsigned end;
+            if (!n) n=1;
+            end = pos + n;
+            while (pos<end) table[pos++]=(U16)((s * 40503U) & mask);
+            s++;
+            remaining -= n;
+        }
+
+    for (size_t i = 0; i < nbSymbols; i++)
+        buffer[i] = table[DG_rand(&seed) & (PROBATABLESIZE16-1)];
+}
+
+double DG_entropy(const DG_spec_t *spec)
+{
+    static BYTE table[ZIPFTABLESIZE];
+
+    switch (spec->dist) {
+    case DG_GEOMETRIC:
+        DG_geometricTable(table, spec->param);
+        return DG_tableEntropy(table, PROBATABLESIZE);
+    case DG_UNIFORM:
+        return log2(spec->param < 1 ? 1 : spec->param > 256 ? 256 : (U32)spec->param);
+    case DG_ZIPF:
+        DG_zipfTable(table, spec->param);
+        return DG_tableEntropy(table, ZIPFTABLESIZE);
+    case DG_RUNS:
+        return 8;  // every run byte is uniform
+    case DG_ALTERNATE:
+        return (U32)spec->param & 255 ? 1 : 0;
+    case DG_CONSTANT:
+        return 0;
+    case DG_TEXT:
+    default:
+        DG_generate(table, TEXT_SAMPLE, spec);
+        return DG_measureEntropy(table, TEXT_SAMPLE);
+    }
+}
+
+double DG_measureEntropy(const void *buffer, size_t size)
+{
+    const BYTE *ip = (const BYTE *)buffer;
+    size_t count[256] = { 0 };
+    double entropy = 0;
+
+    for (size_t i = 0; i < size; i++) count[ip[i]]++;
+    for (int k = 0; k < 256; k++)
+        if (count[k]) entropy -= (double)count[k] / size * log2((double)count[k] / size);
+    return entropy;
+}
+
+int DG_calibrate(DG_spec_t *spec, double targetBits)
+{
+    double low, high;
+
+    if (targetBits < 0) targetBits = 0;
+    if (targetBits > 8) targetBits = 8;
+    switch (spec->dist) {
+    case DG_UNIFORM:
+        spec->param = (U32)(pow(2, targetBits) + 0.5);
+        return 0;
+    case DG_GEOMETRIC:
+        low = 0.005, high = 1;
+        break;
+    case DG_ZIPF:
+        low = 0, high = 16;
+        break;
+    default:
+        return -1;
+    }
+
+    // entropy falls as the parameter grows
+    for (int step = 0; step < 40; step++) {
+        spec->param = (low + high) / 2;
+        if (DG_entropy(spec) > targetBits) low = spec->param;
+        else high = spec->param;
+    }
+    spec->param = (low + high) / 2;
+    return 0;
+}
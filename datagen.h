@@ -0,0 +1,70 @@
+/*
+  datagen.h - synthetic inputs for the histogram benchmark
+  Copyright (C) Yann Collet 2012-2014  GPL v2 License
+
+  Every distribution is reproducible: the same spec, seed and size always
+  give the same bytes.  Build with the line at the top of countbench.c.
+*/
+
+#ifndef DATAGEN_H
+#define DATAGEN_H
+
+#include <stddef.h>    // size_t
+#include <stdint.h>    // uintX_t types
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+// Distributions, written "name[:param]" on the command line:
+//   geometric:p  the original countbench curve, p in (0,1] (default 0.2)
+//   uniform:n    bytes 0..n-1, equally likely (default 256)
+//   zipf:s       byte k with probability ~ 1/(k+1)^s (default 1)
+//   runs:l       runs of one random byte, l bytes long on average (default 16)
+//   alternate:b  0, b, 0, b, ... (default 1): store forwarding on two bins
+//   constant:b   b only (default 0): the worst case for a single table
+//   text         English-like words, spaces and punctuation
+typedef enum {
+    DG_GEOMETRIC,
+    DG_UNIFORM,
+    DG_ZIPF,
+    DG_RUNS,
+    DG_ALTERNATE,
+    DG_CONSTANT,
+    DG_TEXT,
+    DG_NB_DISTS
+} DG_dist_t;
+
+typedef struct {
+    DG_dist_t dist;
+    double param;
+    unsigned seed;
+} DG_spec_t;
+
+// Fill spec from "name[:param]", with the default param if none is given.
+// Returns 0, or -1 for an unknown name.
+int DG_parseSpec(const char *text, DG_spec_t *spec);
+const char *DG_distName(DG_dist_t dist);
+// "zipf:1.20" style name of spec, into out[outSize]
+void DG_specName(const DG_spec_t *spec, char *out, size_t outSize);
+
+void DG_generate(void *buffer, size_t size, const DG_spec_t *spec);
+// 16-bit symbols on the geometric curve (spec->param is p), spread over
+// 2^symbolBits values so the frequent ones don't share cache lines
+void DG_generate16(uint16_t *buffer, size_t nbSymbols, const DG_spec_t *spec, unsigned symbolBits);
+
+// Order-0 entropy in bits per byte: of the distribution itself (exact for
+// the table driven ones: geometric, uniform, zipf, constant, alternate),
+// and as measured on a buffer
+double DG_entropy(const DG_spec_t *spec);
+double DG_measureEntropy(const void *buffer, size_t size);
+
+// Set spec->param so that DG_entropy(spec) is targetBits (0 to 8).
+// Returns 0, or -1 if the distribution has no entropy parameter.
+int DG_calibrate(DG_spec_t *spec, double targetBits);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif // DATAGEN_H
@@ -0,0 +1,2654 @@
+// cc -std=gnu99 -Wall -Wextra -O3 -c histogram.c -o histogram.o && ar rcs libhistogram.a histogram.o
+// No -march flag is needed: kernels that use SSE4.1/AVX/AVX2 are compiled
+// with target attributes and picked at run time (see HIST_variants()).
+// (programs linking libhistogram.a also need -lpthread for HIST_countParallel)
+// or as a shared object: cc -std=gnu99 -Wall -Wextra -O3 -fPIC -shared histogram.c -o libhistogram.so -lpthread
+// Byte histogram kernels split out of countbench.c so they can be linked into other programs.
+// Every kernel fills the caller's count[HIST_SYMBOLS]; countbench.c only times them.
+
+/*
+  Based on fullbench.c - Demo program to benchmark open-source compression algorithm
+  Copyright (C) Yann Collet 2012-2014  GPL v2 License
+  - public forum : https://groups.google.com/forum/#!forum/lz4c
+  - website : http://fastcompression.blogspot.com/
+*/
+
+#define _GNU_SOURCE    // cpu_set_t, pthread_attr_setaffinity_np()
+#include <stdlib.h>    // free(), qsort()
+#include <stdio.h>     // printf()
+#include <string.h>    // memset()
+#include <stdint.h>    // int/uintX_t types
+#include <x86intrin.h> // vector intrinsics (per-function target attributes)
+#include <malloc.h>    // memalign()
+#include <ctype.h>     // isspace()
+#include <pthread.h>   // pthread_create()
+#include <sched.h>     // sched_setaffinity()
+#include <unistd.h>    // syscall()
+#include <sys/mman.h>  // mmap(), madvise()
+#include <sys/syscall.h> // SYS_mbind
+
+#include "histogram.h"
+
+typedef uint8_t  BYTE;
+typedef uint16_t U16;
+typedef uint32_t U32;
+typedef  int32_t S32;
+typedef uint64_t U64;
+
+#ifdef IACA
+// cc -march=native -std=gnu11 -Wall -Wextra -O3 -c histogram.c -DIACA -o iaca.o
+// iaca  -mark 0 -64 -arch HSW -analysis THROUGHPUT iaca.o
+#include </opt/intel/iaca/include/iacaMarks.h>
+#else
+#define IACA_START
+#define IACA_END
+#endif
+
+#ifndef DEBUG
+#define DEBUG_PRINT(format, args...)
+#define DEBUG_ASSERT(test, args...)
+#define DEBUG_ALWAYS(actions...)
+#define DEBUG_IS_ACTIVE 0
+#define DEBUG_ACTIVE(actions...)
+#else // DEBUG
+// cc -g -march=native -std=gnu99 -Wall -Wextra -O3 countbench.c histogram.c datagen.c -o countbench -DDEBUG
+// DEBUG=triv* countbench -P90 -b1 | head -2
+
+/* If the program has been compiled with -DDEBUG, debug printing can be 
+   turned on using the environment variable DEBUG.  This can be set from 
+   the command line as 'DEBUG=foo_* program'. 
+
+      func_exact              -> function exactly 'func_exact'
+      func_wild*              -> function starting with 'func_wild'
+      *                       -> all functions
+
+   The wildcard character '*' may only go at the end of an identifier.
+   Multiple conditions should be comma separated: 'DEBUG=func1_*,func2_*'
+   Whitespace before or after a separating comma is allowed and ignored.
+*/
+
+#define COMPILER_POSSIBLY_UNUSED __attribute__((unused))   
+
+#define DEBUG_PRINT_INTERNAL(format, args...)                          \
+    do {                                                               \
+        if (! isspace(*format)) {                                      \
+            fprintf(stderr, "%s:%d %s(): ", __FILE__, __LINE__, __func__);  \
+        }                                                              \
+        fprintf(stderr, format "\n" , ## args);   \
+    } while (0)
+
+// abort on error if test fails
+#define DEBUG_ASSERT(test, args...)                                    \
+    do {                                                               \
+        if (!(test)) {                                                 \
+            DEBUG_PRINT_INTERNAL("ASSERT FAILED (" #test ")\n" args);  \
+            abort();                                                   \
+        }                                                              \
+    } while (0)        
+
+// print according to $ENV{DEBUG} matching function name
+#define DEBUG_PRINT(format, args...)                                   \
+    do {                                                               \
+        if (debug_should_print(__func__)) {                            \
+                DEBUG_PRINT_INTERNAL(format , ## args);                \
+        }                                                              \
+    } while (0)
+
+// shorthand for #if DEBUG { actions } #endif  (always executes on -DDEBUG)
+#define DEBUG_ALWAYS(actions...)  actions
+
+// boolean to determine if $ENV{DEBUG} includes the current fucntions
+#define DEBUG_IS_ACTIVE (debug_should_print(__func__))
+
+#define DEBUG_ACTIVE(actions...) if (DEBUG_IS_ACTIVE) { (actions); } 
+
+// strategy is to allocate nothing so nothing leaks
+COMPILER_POSSIBLY_UNUSED static int debug_should_print(const char *func) {
+    static char *debug_env; // static variable per compilation unit
+    
+    if (! debug_env) { // cache result of getenv()
+        debug_env = getenv("DEBUG");
+        if (! debug_env) debug_env = "";
+    }
+
+    char *test = debug_env;
+    if (*test == '*') return 1; 
+    if (*test == '\0') return 0;
+
+    size_t func_len = strlen(func);
+
+    while (1) {
+        while(isspace(*test)) test++; // skip leading whitespace
+        if (! *test) return 0;        // 'not found' if end of string
+
+        char *next = strchr(test, ',');
+        char *last = next ? next - 1 : test + strlen(test) - 1;
+        while (isspace(*last)) last--; // skip trailing whitespace
+        size_t len = 1 + last - test;
+        
+        if (test[len - 1] == '*') {   // match to wildcard if there is one
+            if (! memcmp(test, func, len - 1)) return 1;
+        } else {                      // otherwise must match whole string
+            if (func_len == len && !memcmp(test, func, len)) return 1;
+        }
+        
+        if (next) test = next + 1;    // skip over comma and check next
+        else return 0;                // 'not found' if no next exists
+    }
+}
+
+#endif // DEBUG
+
+int trivialCount(const uint8_t *src, size_t srcSize, U32 *bin)
+{
+    memset(bin, 0, HIST_SYMBOLS * sizeof(*bin));  // 256 counters starting at zero
+
+    // increment counter in bin matching each byte
+    const uint8_t *end  = src + srcSize;
+    while (src < end) {
+        DEBUG_ACTIVE(printf("%d ", *src * 4));
+        bin[*src++]++;
+    }
+
+    if (DEBUG_IS_ACTIVE) {
+        printf("\n");
+        for (int i = 0; i < 256; i++) {
+            printf("%d ", bin[i]);
+        }
+        printf("\n");
+    }
+
+    return bin[0];
+}
+
+// overallocate individual count tables to avoid 4K aliasing of 
+// same byte within different tables (helps avoid CPU misspeculation)
+#define COUNT_SIZE HIST_COUNT_SIZE  // (256 + 8)
+
+// Sub-histograms are per thread so that kernels can run on many cores at
+// once.  The port 7 kernels' inline asm takes the table's address in a
+// register and addresses it as offset(%base,%reg): naming the symbol
+// (%fs:t_count@tpoff) would tie the object to the local-exec TLS model,
+// which fails to link under LTO or when a non-PIC object ends up in a
+// shared library.  The address is computed once, outside the loop.
+static __thread U32 t_count[16][COUNT_SIZE] __attribute__((aligned(64)));
+
+#define TLS_ADDR(sym, offset, reg) offset "(%[tls]," reg ")"
+#define TLS_OPERAND(sym) , [tls] "r" (sym)
+
+// Bounce buffer of the port 7 kernels (port7vec: 2x32B, vecavx: 4x16B),
+// kept per thread instead of allocated on every call
+static __thread uint8_t t_bounce[64] __attribute__((aligned(64)));
+
+// Sum nbTables padded sub-tables into bin[] (or add them to it, if
+// accumulate), 8 bins per instruction with AVX2 and 4 with SSE2.  Shared
+// by every kernel that counts into t_count: the scalar version was 3840
+// adds, the bulk of the time for 1-4 KB blocks.
+// Four independent sums per pass, so the adds of one bin chunk don't wait
+// on each other down the 16 tables.
+__attribute__((target("avx2")))
+static void HIST_reduceAVX2(U32 (*tables)[COUNT_SIZE], size_t nbTables, size_t nbBins, U32 *bin, int accumulate)
+{
+    for (size_t b = 0; b < nbBins; b += 32) {
+        __m256i sum[4];
+        for (int k = 0; k < 4; k++)
+            sum[k] = accumulate ? _mm256_loadu_si256((const __m256i *)(bin + b + 8*k))
+                                : _mm256_setzero_si256();
+        for (size_t t = 0; t < nbTables; t++) {
+            for (int k = 0; k < 4; k++)
+                sum[k] = _mm256_add_epi32(sum[k], _mm256_load_si256((const __m256i *)&tables[t][b + 8*k]));
+        }
+        for (int k = 0; k < 4; k++) _mm256_storeu_si256((__m256i *)(bin + b + 8*k), sum[k]);
+    }
+}
+
+static void HIST_reduceSSE2(U32 (*tables)[COUNT_SIZE], size_t nbTables, size_t nbBins, U32 *bin, int accumulate)
+{
+    for (size_t b = 0; b < nbBins; b += 16) {
+        __m128i sum[4];
+        for (int k = 0; k < 4; k++)
+            sum[k] = accumulate ? _mm_loadu_si128((const __m128i *)(bin + b + 4*k))
+                                : _mm_setzero_si128();
+        for (size_t t = 0; t < nbTables; t++) {
+            for (int k = 0; k < 4; k++)
+                sum[k] = _mm_add_epi32(sum[k], _mm_load_si128((const __m128i *)&tables[t][b + 4*k]));
+        }
+        for (int k = 0; k < 4; k++) _mm_storeu_si128((__m128i *)(bin + b + 4*k), sum[k]);
+    }
+}
+
+// nbBins is a multiple of 32
+static void HIST_reduceBins(U32 (*tables)[COUNT_SIZE], size_t nbTables, size_t nbBins, U32 *bin, int accumulate)
+{
+    if (__builtin_cpu_supports("avx2")) HIST_reduceAVX2(tables, nbTables, nbBins, bin, accumulate);
+    else HIST_reduceSSE2(tables, nbTables, nbBins, bin, accumulate);
+}
+
+static void HIST_reduce(U32 (*tables)[COUNT_SIZE], size_t nbTables, U32 *bin, int accumulate)
+{
+    HIST_reduceBins(tables, nbTables, HIST_SYMBOLS, bin, accumulate);
+}
+
+// total += add, for HIST_SYMBOLS counters
+__attribute__((target("avx2")))
+static void HIST_widenCountsAVX2(U64 *total, const U32 *add)
+{
+    for (int i = 0; i < HIST_SYMBOLS; i += 4) {
+        __m256i wide = _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i *)&add[i]));
+        __m256i vec = _mm256_loadu_si256((const __m256i *)&total[i]);
+        _mm256_storeu_si256((__m256i *)&total[i], _mm256_add_epi64(vec, wide));
+    }
+}
+
+static void HIST_widenCountsSSE2(U64 *total, const U32 *add)
+{
+    const __m128i zero = _mm_setzero_si128();
+    for (int i = 0; i < HIST_SYMBOLS; i += 4) {
+        __m128i narrow = _mm_loadu_si128((const __m128i *)&add[i]);
+        __m128i lo = _mm_loadu_si128((const __m128i *)&total[i]);
+        __m128i hi = _mm_loadu_si128((const __m128i *)&total[i + 2]);
+        lo = _mm_add_epi64(lo, _mm_unpacklo_epi32(narrow, zero));
+        hi = _mm_add_epi64(hi, _mm_unpackhi_epi32(narrow, zero));
+        _mm_storeu_si128((__m128i *)&total[i], lo);
+        _mm_storeu_si128((__m128i *)&total[i + 2], hi);
+    }
+}
+
+static void HIST_widenCounts(U64 *total, const U32 *add)
+{
+    if (__builtin_cpu_supports("avx2")) HIST_widenCountsAVX2(total, add);
+    else HIST_widenCountsSSE2(total, add);
+}
+
+// total += the sum of the tables, for 64-bit totals (the stream API).
+// The tables together must hold less than 2^32 per bin, as they do
+// between two flushes.
+static void HIST_reduce64(U32 (*tables)[COUNT_SIZE], size_t nbTables, U64 *total)
+{
+    U32 sum[HIST_SYMBOLS];
+    HIST_reduce(tables, nbTables, sum, 0);
+    HIST_widenCounts(total, sum);
+}
+
+
+#define ASM_INC_OFFSET_BASE_INDEX_SCALE(base, offset, index, scale)     \
+    __asm volatile ("incl %c0(%1, %2, %c3)":                            \
+                    :    /* no registers written (only memory) */       \
+                    "i" (offset), /* constant array offset */           \
+                    "r" (base),  /* read only */                        \
+                    "r" (index),  /* read only */                       \
+                    "i" (scale):  /* constant [1,2,4,8] */              \
+                    "memory" /* clobbers */                             \
+                    )
+
+// This function is limited by the number of uops in the loop.  Sustained throughput is
+// limited to 4 per cycle, and we use about 100.   If you can figure out how to reduce the number
+// of uops in the loop (uops, not instructions) this loop should run faster.  
+
+// try using vector shift with extract to utilize port 7
+
+typedef __m128i xmm_t;
+__attribute__((target("sse4.1")))
+int count_vec(const uint8_t *src, size_t srcSize, U32 *bin)
+{
+    memset(t_count, 0, sizeof(t_count));
+    size_t remainder = srcSize % 16;
+    srcSize = srcSize - remainder;
+    // leave the last full vector to the scalar tail so that loading
+    // nextVec never reads past the end of src
+    if (srcSize) {
+        srcSize -= 16;
+        remainder += 16;
+    }
+    xmm_t nextVec = srcSize ? _mm_loadu_si128((const xmm_t *)&src[0]) : _mm_setzero_si128();
+
+    /* IACA_START; */
+    for (size_t i = 16; i <= srcSize; i += 16) {
+
+        uint64_t byte;
+
+        xmm_t vec = nextVec;
+        nextVec = _mm_loadu_si128((const xmm_t *)&src[i]);
+
+        byte = _mm_extract_epi8(vec, 0);
+        ASM_INC_OFFSET_BASE_INDEX_SCALE(t_count, COUNT_SIZE * 4 * 0, byte, 4);
+
+        byte = _mm_extract_epi8(vec, 1);
+        ASM_INC_OFFSET_BASE_INDEX_SCALE(t_count, COUNT_SIZE * 4 * 1, byte, 4);
+
+        byte = _mm_extract_epi8(vec, 2);
+        ASM_INC_OFFSET_BASE_INDEX_SCALE(t_count, COUNT_SIZE * 4 * 2, byte, 4);
+
+        byte = _mm_extract_epi8(vec, 3);
+        ASM_INC_OFFSET_BASE_INDEX_SCALE(t_count, COUNT_SIZE * 4 * 3, byte, 4);
+
+        byte = _mm_extract_epi8(vec, 4);
+        ASM_INC_OFFSET_BASE_INDEX_SCALE(t_count, COUNT_SIZE * 4 * 4, byte, 4);
+
+        byte = _mm_extract_epi8(vec, 5);
+        ASM_INC_OFFSET_BASE_INDEX_SCALE(t_count, COUNT_SIZE * 4 * 5, byte, 4);
+
+        byte = _mm_extract_epi8(vec, 6);
+        ASM_INC_OFFSET_BASE_INDEX_SCALE(t_count, COUNT_SIZE * 4 * 6, byte, 4);
+
+        byte = _mm_extract_epi8(vec, 7);
+        ASM_INC_OFFSET_BASE_INDEX_SCALE(t_count, COUNT_SIZE * 4 * 7, byte, 4);
+
+        byte = _mm_extract_epi8(vec, 8);
+        ASM_INC_OFFSET_BASE_INDEX_SCALE(t_count, COUNT_SIZE * 4 * 8, byte, 4);
+
+        byte = _mm_extract_epi8(vec, 9);
+        ASM_INC_OFFSET_BASE_INDEX_SCALE(t_count, COUNT_SIZE * 4 * 9, byte, 4);
+
+        byte = _mm_extract_epi8(vec, 10);
+        ASM_INC_OFFSET_BASE_INDEX_SCALE(t_count, COUNT_SIZE * 4 * 10, byte, 4);
+
+        byte = _mm_extract_epi8(vec, 11);
+        ASM_INC_OFFSET_BASE_INDEX_SCALE(t_count, COUNT_SIZE * 4 * 11, byte, 4);
+
+        byte = _mm_extract_epi8(vec, 12);
+        ASM_INC_OFFSET_BASE_INDEX_SCALE(t_count, COUNT_SIZE * 4 * 12, byte, 4);
+
+        byte = _mm_extract_epi8(vec, 13);
+        ASM_INC_OFFSET_BASE_INDEX_SCALE(t_count, COUNT_SIZE * 4 * 13, byte, 4);
+
+        byte = _mm_extract_epi8(vec, 14);
+        ASM_INC_OFFSET_BASE_INDEX_SCALE(t_count, COUNT_SIZE * 4 * 14, byte, 4);
+
+        byte = _mm_extract_epi8(vec, 15);
+        ASM_INC_OFFSET_BASE_INDEX_SCALE(t_count, COUNT_SIZE * 4 * 15, byte, 4);
+
+    }
+
+    src += srcSize;  // skip over the finished part
+    for (size_t i = 0; i < remainder; i++) {
+        uint64_t byte = src[i];
+        ASM_INC_OFFSET_BASE_INDEX_SCALE(t_count, 0, byte, 4);
+    }
+
+    // sum 256 byte counters in 16 separate arrays into bin[byte]
+    HIST_reduce(t_count, 16, bin, 0);
+
+    return bin[0];
+}
+
+
+// Port 7 friendly increment
+#define ASM_INC_OFFSET_BASE_INDEX(global, offset, index)                \
+    __asm volatile (                                                    \
+                    "incl " TLS_ADDR(global, "%c0", "%1") "\n":           \
+                    : /* nothing written except memory */               \
+                    "i" (offset),  /* which array */                    \
+                    "r" (index)    /* pre-shifted index */              \
+                    TLS_OPERAND(global):                                \
+                    "memory" /* clobbers */                             \
+                                                                        )
+
+#define ASM_LOAD_WORD_FROM_BUFFER(buffer, offset, dest)                 \
+    __asm volatile (                                                    \
+                    "movzwl %c1(%2), %k0\n":                            \
+                    "=r" (dest) :  /* 32-bit write */                   \
+                    "i" (offset),  /* byte offset */                    \
+                    "r" (buffer)  /* buffer base */                     \
+                                                                        )
+
+
+#define ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(offset, ptr, index, scale, destVec) \
+    __asm volatile (                                                    \
+                    "vpmovzxbw %c1(%2, %3, %c4), %0\n":                 \
+                    "=x" (destVec) :  /* vector write */                \
+                    "i" (offset),                                       \
+                    "r" (ptr),   /* ptr */                              \
+                    "r" (index),  /* offset */                          \
+                    "i" (scale)  /* [1,2,4,8] */                        \
+                                                                        )
+
+#define ASM_COMPILER_MEM_BARRIER()                                      \
+    __asm volatile( "" /* no asm */ :                                   \
+                    /* nothing written */ :                             \
+                    /* nothing read */ :                                \
+                    /* pretend to clobber */ "memory");
+
+
+typedef __m256i ymm_t;
+__attribute__((target("avx2")))
+int port7vec(const uint8_t *src, size_t srcSize, U32 *bin)
+{
+    // the pipeline needs 8 bytes preloaded plus 64 bytes of read-ahead
+    if (srcSize < 72) return trivialCount(src, srcSize, bin);
+
+    memset(t_count, 0, sizeof(t_count));
+
+    // 2x32B buffers with 64B alignment
+    uint8_t *buffer = t_bounce;
+    
+    // index == byte * 4 (pre-shifted)
+    uint64_t index0, index1, index2, index3;
+    uint64_t index4, index5, index6, index7;
+
+    ASM_COMPILER_MEM_BARRIER();
+
+    ymm_t vec0, vec1;
+    vec0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const xmm_t *)&src[0]));
+    vec0 = _mm256_slli_epi16(vec0, 2);
+    _mm256_store_si256((ymm_t *)buffer, vec0);
+
+    ASM_COMPILER_MEM_BARRIER();
+
+    DEBUG_PRINT("Original src %p endSrc %p loaded %p ", src, src + srcSize, &src[0]);
+    
+    // start with registers loaded
+    ASM_LOAD_WORD_FROM_BUFFER(buffer, 0 * 2, index0);
+    ASM_LOAD_WORD_FROM_BUFFER(buffer, 1 * 2, index1);
+    ASM_LOAD_WORD_FROM_BUFFER(buffer, 2 * 2, index2);
+    ASM_LOAD_WORD_FROM_BUFFER(buffer, 3 * 2, index3);
+    ASM_LOAD_WORD_FROM_BUFFER(buffer, 4 * 2, index4);
+    ASM_LOAD_WORD_FROM_BUFFER(buffer, 5 * 2, index5);
+    ASM_LOAD_WORD_FROM_BUFFER(buffer, 6 * 2, index6);
+    ASM_LOAD_WORD_FROM_BUFFER(buffer, 7 * 2, index7);
+    src += 8;
+    srcSize -= 8;
+
+    size_t remainder = srcSize % 32;
+    remainder += 64;
+    srcSize = srcSize - remainder;
+    const uint8_t *endSrc = src + srcSize;
+    int64_t negCount = -srcSize;
+
+
+    // need to start with both buffers full
+    ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(0, endSrc, negCount, 1, vec1);
+    vec1 = _mm256_slli_epi16(vec1, 2);
+    _mm256_store_si256((ymm_t *)buffer, vec1);
+
+    ASM_COMPILER_MEM_BARRIER();
+
+    ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(16, endSrc, negCount, 1, vec0);
+    vec0 = _mm256_slli_epi16(vec0, 2);
+    _mm256_store_si256((ymm_t *)(buffer + 32), vec0);
+
+    ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(32, endSrc, negCount, 1, vec0); 
+
+    IACA_START;
+
+    while (negCount != 0) {
+        // software prefetch because hardware does not cross 4K pages
+        _mm_prefetch((const char *)(endSrc + negCount + 768), 3);
+
+        vec0 = _mm256_slli_epi16(vec0, 2);
+
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 0, index0);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 0 * 2, index0);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 1, index1);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 1 * 2, index1);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 2, index2);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 2 * 2, index2);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 3, index3);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 3 * 2, index3);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 4, index4);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 4 * 2, index4);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 5, index5);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 5 * 2, index5);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 6, index6);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 6 * 2, index6);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 7, index7);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 7 * 2, index7);
+
+        ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(48, endSrc, negCount, 1, vec1); 
+
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 8, index0);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 8 * 2, index0);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 9, index1);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 9 * 2, index1);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 10, index2);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 10 * 2, index2);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 11, index3);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 11 * 2, index3);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 12, index4);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 12 * 2, index4);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 13, index5);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 13 * 2, index5);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 14, index6);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 14 * 2, index6);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 15, index7);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 15 * 2, index7);
+
+
+        vec1 = _mm256_slli_epi16(vec1, 2);
+        _mm256_store_si256((ymm_t *)buffer, vec0);
+
+
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 0, index0);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 0 * 2, index0);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 1, index1);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 1 * 2, index1);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 2, index2);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 2 * 2, index2);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 3, index3);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 3 * 2, index3);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 4, index4);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 4 * 2, index4);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 5, index5);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 5 * 2, index5);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 6, index6);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 6 * 2, index6);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 7, index7);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 7 * 2, index7);
+
+        //        ASM_COMPILER_MEM_BARRIER();
+        ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(64, endSrc, negCount, 1, vec0); 
+
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 8, index0);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 8 * 2, index0);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 9, index1);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 9 * 2, index1);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 10, index2);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 10 * 2, index2);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 11, index3);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 11 * 2, index3);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 12, index4);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 12 * 2, index4);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 13, index5);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 13 * 2, index5);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 14, index6);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 14 * 2, index6);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 15, index7);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 15 * 2, index7);
+
+        _mm256_store_si256((ymm_t *)(buffer + 32), vec1);
+
+        negCount += 32;
+    }
+
+    IACA_END;
+
+    remainder += 8;  // loaded to registers but unused
+    endSrc -= 8;     // portion that needs to be reread
+
+    DEBUG_PRINT("|");
+    for (size_t i = 0; i < remainder; i++) {
+        uint64_t byte = endSrc[i];
+        DEBUG_PRINT("%ld ", byte * 4);
+        t_count[0][byte]++;
+    }
+    DEBUG_PRINT("\n");
+
+    // sum 256 byte counters in 16 separate arrays into bin[byte]
+    HIST_reduce(t_count, 16, bin, 0);
+    for (int i = 0; i < 256; i++) DEBUG_PRINT("%d ", bin[i]);
+    DEBUG_PRINT("\n");
+
+    return bin[0];
+}
+
+typedef __m512i zmm_t;
+
+// AVX-512 (Skylake-X, Ice Lake): gather 16 counters, add, scatter back,
+// so there are no scalar increments and no byte extraction at all.  Each
+// lane owns one of the 16 sub-tables, so lanes of one vector can never hit
+// the same counter and no vpconflictd is needed (tried: its microcode made
+// the kernel half as fast).  Two vectors share the lane tables; where they
+// hold the same byte the first one is masked out of its scatter and the
+// second adds 2, so the hot byte of skewed data costs one scatter-to-gather
+// round trip per 32 bytes instead of two.
+__attribute__((target("avx512f")))
+int scatter512(const uint8_t *src, size_t srcSize, U32 *bin)
+{
+    U32 *counts = t_count[0];
+    const zmm_t one = _mm512_set1_epi32(1);
+    const zmm_t lane = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+                                                            10, 11, 12, 13, 14, 15),
+                                          _mm512_set1_epi32(COUNT_SIZE));
+    size_t i = 0;
+
+    memset(t_count, 0, sizeof(t_count));
+
+    for (; i + 32 <= srcSize; i += 32) {
+        zmm_t idx0 = _mm512_cvtepu8_epi32(_mm_loadu_si128((const xmm_t *)(src + i)));
+        zmm_t idx1 = _mm512_cvtepu8_epi32(_mm_loadu_si128((const xmm_t *)(src + i + 16)));
+        idx0 = _mm512_add_epi32(idx0, lane);
+        idx1 = _mm512_add_epi32(idx1, lane);
+
+        __mmask16 same = _mm512_cmpeq_epi32_mask(idx0, idx1);
+        zmm_t old0 = _mm512_i32gather_epi32(idx0, (const void *)counts, 4);
+        zmm_t old1 = _mm512_i32gather_epi32(idx1, (const void *)counts, 4);
+        old1 = _mm512_mask_add_epi32(old1, same, old1, one);
+        _mm512_mask_i32scatter_epi32((void *)counts, (__mmask16)~same, idx0,
+                                     _mm512_add_epi32(old0, one), 4);
+        _mm512_i32scatter_epi32((void *)counts, idx1, _mm512_add_epi32(old1, one), 4);
+    }
+    for (; i < srcSize; i++) t_count[0][src[i]]++;
+
+    // sum 256 byte counters in 16 separate arrays into bin[byte]
+    HIST_reduce(t_count, 16, bin, 0);
+
+    return bin[0];
+}
+
+__attribute__((target("avx")))
+int vecavx(const uint8_t *src, size_t srcSize, U32 *bin)
+{
+    // the pipeline needs 8 bytes preloaded plus 64 bytes of read-ahead
+    if (srcSize < 72) return trivialCount(src, srcSize, bin);
+
+    memset(t_count, 0, sizeof(t_count));
+
+    // 4x16B buffers with 64B alignment (overcommit for same offsets as AVX2)
+    uint8_t *buffer = t_bounce;
+    
+    // index == byte * 4 (pre-shifted)
+    uint64_t index0, index1, index2, index3;
+    uint64_t index4, index5, index6, index7;
+
+    xmm_t vec0, vec1, vec2, vec3;
+    vec0 = _mm_cvtepu8_epi16(_mm_loadu_si128((const xmm_t *)&src[0]));
+    vec0 = _mm_slli_epi16(vec0, 2);
+    vec1 = _mm_cvtepu8_epi16(_mm_loadu_si128((const xmm_t *)&src[16]));
+    vec1 = _mm_slli_epi16(vec1, 2);
+    _mm_store_si128((xmm_t *)(buffer +  0), vec0);
+    _mm_store_si128((xmm_t *)(buffer + 16), vec1);
+
+    ASM_COMPILER_MEM_BARRIER();
+
+    // start with registers loaded
+    ASM_LOAD_WORD_FROM_BUFFER(buffer, 0 * 2, index0);
+    ASM_LOAD_WORD_FROM_BUFFER(buffer, 1 * 2, index1);
+    ASM_LOAD_WORD_FROM_BUFFER(buffer, 2 * 2, index2);
+    ASM_LOAD_WORD_FROM_BUFFER(buffer, 3 * 2, index3);
+    ASM_LOAD_WORD_FROM_BUFFER(buffer, 4 * 2, index4);
+    ASM_LOAD_WORD_FROM_BUFFER(buffer, 5 * 2, index5);
+    ASM_LOAD_WORD_FROM_BUFFER(buffer, 6 * 2, index6);
+    ASM_LOAD_WORD_FROM_BUFFER(buffer, 7 * 2, index7);
+    src += 8;
+    srcSize -= 8;
+
+
+    size_t remainder = srcSize % 32;
+    remainder += 64;
+    srcSize = srcSize - remainder;
+    const uint8_t *endSrc = src + srcSize;
+    int64_t negCount = -srcSize;
+
+    // need to start with both buffers full
+    ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(0, endSrc, negCount, 1, vec2);
+    ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(8, endSrc, negCount, 1, vec3);
+    vec2 = _mm_slli_epi16(vec2, 2);
+    _mm_store_si128((xmm_t *)(buffer + 0), vec2);
+    vec3 = _mm_slli_epi16(vec3, 2);
+    _mm_store_si128((xmm_t *)(buffer + 16), vec3);
+
+
+    ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(16, endSrc, negCount, 1, vec0);
+    ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(24, endSrc, negCount, 1, vec1);
+    vec0 = _mm_slli_epi16(vec0, 2);
+    _mm_store_si128((xmm_t *)(buffer + 32), vec0);
+    vec1 = _mm_slli_epi16(vec1, 2);
+    _mm_store_si128((xmm_t *)(buffer + 48), vec1);
+
+    ASM_COMPILER_MEM_BARRIER();
+
+    ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(32, endSrc, negCount, 1, vec0); 
+    ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(40, endSrc, negCount, 1, vec1); 
+
+    IACA_START;
+
+    while (negCount != 0) {
+        _mm_prefetch((const char *)(endSrc + negCount + 768), 3);
+        vec0 = _mm_slli_epi16(vec0, 2);
+        vec1 = _mm_slli_epi16(vec1, 2);
+
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 0, index0);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 0 * 2, index0);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 1, index1);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 1 * 2, index1);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 2, index2);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 2 * 2, index2);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 3, index3);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 3 * 2, index3);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 4, index4);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 4 * 2, index4);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 5, index5);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 5 * 2, index5);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 6, index6);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 6 * 2, index6);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 7, index7);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 7 * 2, index7);
+
+        ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(48, endSrc, negCount, 1, vec2); 
+        ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(56, endSrc, negCount, 1, vec3); 
+
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 8, index0);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 8 * 2, index0);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 9, index1);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 9 * 2, index1);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 10, index2);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 10 * 2, index2);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 11, index3);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 11 * 2, index3);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 12, index4);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 12 * 2, index4);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 13, index5);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 13 * 2, index5);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 14, index6);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 14 * 2, index6);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 15, index7);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 15 * 2, index7);
+
+
+        vec2 = _mm_slli_epi16(vec2, 2);
+        vec3 = _mm_slli_epi16(vec3, 2);
+        _mm_store_si128((xmm_t *)(buffer + 0), vec0);
+        _mm_store_si128((xmm_t *)(buffer + 16), vec1);
+
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 0, index0);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 0 * 2, index0);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 1, index1);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 1 * 2, index1);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 2, index2);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 2 * 2, index2);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 3, index3);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 3 * 2, index3);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 4, index4);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 4 * 2, index4);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 5, index5);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 5 * 2, index5);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 6, index6);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 6 * 2, index6);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 7, index7);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 7 * 2, index7);
+
+        ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(64, endSrc, negCount, 1, vec0); 
+        ASM_LOAD_VEC_BYTE_TO_WORD_OFFSET_PTR_INDEX_SCALE(72, endSrc, negCount, 1, vec1); 
+
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 8, index0);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 8 * 2, index0);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 9, index1);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 9 * 2, index1);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 10, index2);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 10 * 2, index2);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 11, index3);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 11 * 2, index3);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 12, index4);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 12 * 2, index4);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 13, index5);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 13 * 2, index5);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 14, index6);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 14 * 2, index6);
+        ASM_INC_OFFSET_BASE_INDEX(t_count, COUNT_SIZE * 4 * 15, index7);
+        ASM_LOAD_WORD_FROM_BUFFER(buffer, 32 + 15 * 2, index7);
+
+        _mm_store_si128((xmm_t *)(buffer + 32), vec2);
+        _mm_store_si128((xmm_t *)(buffer + 48), vec3);
+
+
+        negCount += 32;
+    }
+
+    IACA_END;
+
+    remainder += 8;  // loaded to registers but unused
+    endSrc -= 8;
+
+    DEBUG_PRINT("|");
+    for (size_t i = 0; i < remainder; i++) {
+        uint64_t byte = endSrc[i];
+        DEBUG_PRINT("%ld ", byte * 4);
+        t_count[0][byte]++;
+    }
+    DEBUG_PRINT("\n");
+
+    // sum 256 byte counters in 16 separate arrays into bin[byte]
+    HIST_reduce(t_count, 16, bin, 0);
+    for (int i = 0; i < 256; i++) DEBUG_PRINT("%d ", bin[i]);
+    DEBUG_PRINT("\n");
+
+    return bin[0];
+}
+
+
+
+// increment a Haswell Port 7 friendly address [constOffset + byte * 4]
+// trying to arrange order to more stores actually happen on Port 7
+#define ASM_INC_GLOBAL_OFFSET_MULTIPLE_BYTES(global, byte0, byte1, byte2, byte3, \
+                                             tmp32_0, tmp32_1, tmp32_2, tmp32_3, \
+                                             offset0, offset1, offset2, offset3) \
+    __asm volatile (                                                    \
+                    "shl $2, %0\n"      /* byte0 *= 2 */                 \
+                    "shl $2, %1\n"      /* byte1 *= 2 */                 \
+                    "shl $2, %2\n"      /* byte2 *= 2 */                 \
+                    "shl $2, %3\n"      /* byte3 *= 2 */                 \
+                    "movl " TLS_ADDR(global, "%c8", "%0") ", %4\n"                    \
+                    "movl " TLS_ADDR(global, "%c9", "%1") ", %5\n"                   \
+                    "movl " TLS_ADDR(global, "%c10", "%2") ", %6\n"                   \
+                    "movl " TLS_ADDR(global, "%c11", "%3") ", %7\n"                   \
+                    "incl %4\n"                                         \
+                    "incl %5\n"                                         \
+                    "incl %6\n"                                         \
+                    "incl %7\n"                                         \
+                    "movl %4, " TLS_ADDR(global, "%c8", "%0") "\n"                    \
+                    "movl %5, " TLS_ADDR(global, "%c9", "%1") "\n"                   \
+                    "movl %6, " TLS_ADDR(global, "%c10", "%2") "\n"                   \
+                    "movl %7, " TLS_ADDR(global, "%c11", "%3") "\n":                  \
+                    "+r" (byte0),  /* read and write */                 \
+                    "+r" (byte1),  /* read and write */                 \
+                    "+r" (byte2),  /* read and write */                 \
+                    "+r" (byte3),  /* read and write */                 \
+                    "=&r" (tmp32_0),                                    \
+                    "=&r" (tmp32_1),                                    \
+                    "=&r" (tmp32_2),                                    \
+                    "=&r" (tmp32_3):                                    \
+                    "i" (offset0),                                      \
+                    "i" (offset1),                                      \
+                    "i" (offset2),                                      \
+                    "i" (offset3)                                       \
+                    TLS_OPERAND(global):                                \
+                    "memory" /* clobbers */                             \
+                                                                        )
+
+int storePort7(const uint8_t *src, size_t srcSize, U32 *bin)
+{
+    size_t remainder = srcSize; // initially only
+    memset(t_count, 0, sizeof(t_count));
+    if (srcSize < 32) {  // or some small number
+        goto handle_remainder;
+    }
+
+    // preload for first loop iteration
+    uint64_t byte0, byte1, byte2, byte3;
+    uint64_t byte4 = *(src + 0);
+    uint64_t byte5 = *(src + 1);
+    uint64_t byte6 = *(src + 2);
+    uint64_t byte7 = *(src + 3);
+    src += 4;
+    srcSize -= 4;
+
+    remainder = srcSize % 16;
+    remainder += 16;  // allow for some safe read-ahead
+    srcSize = srcSize - remainder;
+    const uint8_t *endSrc = src + srcSize;
+
+    IACA_START;
+    while (src < endSrc) {
+        uint32_t tmp32_0, tmp32_1, tmp32_2, tmp32_3;
+        
+        byte0 = *(src + 0);
+        byte1 = *(src + 1);
+        byte2 = *(src + 2);
+        byte3 = *(src + 3);
+
+        ASM_INC_GLOBAL_OFFSET_MULTIPLE_BYTES(t_count, byte4, byte5, byte6, byte7, 
+                                             tmp32_0, tmp32_1, tmp32_2, tmp32_3,
+                                             COUNT_SIZE * 4 * 0, COUNT_SIZE * 4 * 1, 
+                                             COUNT_SIZE * 4 * 2, COUNT_SIZE * 4 * 3);
+        byte4 = *(src + 4);
+        byte5 = *(src + 5);
+        byte6 = *(src + 6);
+        byte7 = *(src + 7);
+        ASM_INC_GLOBAL_OFFSET_MULTIPLE_BYTES(t_count, byte0, byte1, byte2, byte3, 
+                                             tmp32_0, tmp32_1, tmp32_2, tmp32_3,
+                                             COUNT_SIZE * 4 * 4, COUNT_SIZE * 4 * 5, 
+                                             COUNT_SIZE * 4 * 6, COUNT_SIZE * 4 * 7);
+
+        byte0 = *(src + 8);
+        byte1 = *(src + 9);
+        byte2 = *(src + 10);
+        byte3 = *(src + 11);
+        ASM_INC_GLOBAL_OFFSET_MULTIPLE_BYTES(t_count, byte4, byte5, byte6, byte7, 
+                                             tmp32_0, tmp32_1, tmp32_2, tmp32_3,
+                                             COUNT_SIZE * 4 * 8, COUNT_SIZE * 4 * 9, 
+                                             COUNT_SIZE * 4 * 10, COUNT_SIZE * 4 * 11);
+        byte4 = *(src + 12);
+        byte5 = *(src + 13);
+        byte6 = *(src + 14);
+        byte7 = *(src + 15);
+        ASM_INC_GLOBAL_OFFSET_MULTIPLE_BYTES(t_count, byte0, byte1, byte2, byte3, 
+                                             tmp32_0, tmp32_1, tmp32_2, tmp32_3,
+                                             COUNT_SIZE * 4 * 12, COUNT_SIZE * 4 * 13, 
+                                             COUNT_SIZE * 4 * 14, COUNT_SIZE * 4 * 15);
+
+
+        src += 16;
+        IACA_END;
+    }
+
+
+    src -= 4; // redo last four that preloaded
+    remainder += 4;
+
+ handle_remainder:
+    for (size_t i = 0; i < remainder; i++) {
+        uint64_t byte = src[i];
+        t_count[0][byte]++;
+    }
+
+    // sum 256 byte counters in 16 separate arrays into bin[byte]
+    HIST_reduce(t_count, 16, bin, 0);
+
+    return bin[0];
+}
+
+#define ASM_INC_GLOBAL_OFFSET_MULTIPLE_BYTES_RELOAD(global, src, srcOffset, \
+                                                    byte0, byte1, byte2, byte3, \
+                                                    tmp32_0, tmp32_1, tmp32_2, tmp32_3, \
+                                                    offset0, offset1, offset2, offset3) \
+    __asm volatile (                                                    \
+                    "shl $2, %0\n"      /* byte0 *= 2 */                \
+                    "shl $2, %1\n"      /* byte1 *= 2 */                \
+                    "shl $2, %2\n"      /* byte2 *= 2 */                \
+                    "shl $2, %3\n"      /* byte3 *= 2 */                \
+                    "movl " TLS_ADDR(global, "%c8", "%0") ", %4\n"                    \
+                    "movl " TLS_ADDR(global, "%c9", "%1") ", %5\n"                    \
+                    "movl " TLS_ADDR(global, "%c10", "%2") ", %6\n"                   \
+                    "movl " TLS_ADDR(global, "%c11", "%3") ", %7\n"                   \
+                    "incl %4\n"                                         \
+                    "incl %5\n"                                         \
+                    "incl %6\n"                                         \
+                    "incl %7\n"                                         \
+                    "movl %4, " TLS_ADDR(global, "%c8", "%0") "\n"                    \
+                    "movzbl %c13+0(%12), %k0\n"                         \
+                    "movl %5, " TLS_ADDR(global, "%c9", "%1") "\n"                    \
+                    "movzbl %c13+1(%12), %k1\n"                         \
+                    "movl %6, " TLS_ADDR(global, "%c10", "%2") "\n"                   \
+                    "movzbl %c13+2(%12), %k2\n"                         \
+                    "movl %7, " TLS_ADDR(global, "%c11", "%3") "\n"                   \
+                    "movzbl %c13+3(%12), %k3\n" :                       \
+                    "+r" (byte0),  /* read and write */                 \
+                    "+r" (byte1),  /* read and write */                 \
+                    "+r" (byte2),  /* read and write */                 \
+                    "+r" (byte3),  /* read and write */                 \
+                    "=&r" (tmp32_0),                                    \
+                    "=&r" (tmp32_1),                                    \
+                    "=&r" (tmp32_2),                                    \
+                    "=&r" (tmp32_3):                                    \
+                    "i" (offset0),                                      \
+                    "i" (offset1),                                      \
+                    "i" (offset2),                                      \
+                    "i" (offset3),                                      \
+                    "r" (src),                                          \
+                    "i" (srcOffset)                                     \
+                    TLS_OPERAND(global):                                \
+                    "memory" /* clobbers */                             \
+                                                                        )
+
+
+int reloadPort7(const uint8_t *src, size_t srcSize, U32 *bin)
+{
+    size_t remainder = srcSize; // initially only
+    memset(t_count, 0, sizeof(t_count));
+    if (srcSize < 32) {  // or some small number
+        goto handle_remainder;
+    }
+
+    // preload for first loop iteration
+    uint64_t byte0 = *(src + 0);
+    uint64_t byte1 = *(src + 1);
+    uint64_t byte2 = *(src + 2);
+    uint64_t byte3 = *(src + 3);
+    uint64_t byte4 = *(src + 4);
+    uint64_t byte5 = *(src + 5);
+    uint64_t byte6 = *(src + 6);
+    uint64_t byte7 = *(src + 7);
+    src += 8;
+    srcSize -= 8;
+
+    remainder = srcSize % 16;
+    remainder += 16;  // allow for some safe read-ahead
+    srcSize = srcSize - remainder;
+    const uint8_t *endSrc = src + srcSize;
+
+    IACA_START;
+    while (src < endSrc) {
+        uint32_t tmp32_0, tmp32_1, tmp32_2, tmp32_3;
+        
+        ASM_INC_GLOBAL_OFFSET_MULTIPLE_BYTES_RELOAD(t_count, src, 0, byte0, byte1, byte2, byte3, 
+                                                    tmp32_0, tmp32_1, tmp32_2, tmp32_3,
+                                                    COUNT_SIZE * 4 * 0, COUNT_SIZE * 4 * 1, 
+                                                    COUNT_SIZE * 4 * 2, COUNT_SIZE * 4 * 3);
+
+        ASM_INC_GLOBAL_OFFSET_MULTIPLE_BYTES_RELOAD(t_count, src, 4, byte4, byte5, byte6, byte7, 
+                                                    tmp32_0, tmp32_1, tmp32_2, tmp32_3,
+                                                    COUNT_SIZE * 4 * 4, COUNT_SIZE * 4 * 5, 
+                                                    COUNT_SIZE * 4 * 6, COUNT_SIZE * 4 * 7);
+
+        ASM_INC_GLOBAL_OFFSET_MULTIPLE_BYTES_RELOAD(t_count, src, 8, byte0, byte1, byte2, byte3, 
+                                                    tmp32_0, tmp32_1, tmp32_2, tmp32_3,
+                                                    COUNT_SIZE * 4 * 8, COUNT_SIZE * 4 * 9, 
+                                                    COUNT_SIZE * 4 * 10, COUNT_SIZE * 4 * 11);
+        
+        ASM_INC_GLOBAL_OFFSET_MULTIPLE_BYTES_RELOAD(t_count, src, 12, byte4, byte5, byte6, byte7, 
+                                                    tmp32_0, tmp32_1, tmp32_2, tmp32_3,
+                                                    COUNT_SIZE * 4 * 12, COUNT_SIZE * 4 * 13, 
+                                                    COUNT_SIZE * 4 * 14, COUNT_SIZE * 4 * 15);
+
+
+        src += 16;
+        IACA_END;
+
+    }
+
+
+    src -= 8; // redo last four that preloaded
+    remainder += 8;
+
+ handle_remainder:
+    for (size_t i = 0; i < remainder; i++) {
+        uint64_t byte = src[i];
+        t_count[0][byte]++;
+    }
+
+    // sum 256 byte counters in 16 separate arrays into bin[byte]
+    HIST_reduce(t_count, 16, bin, 0);
+
+    return bin[0];
+}
+
+#define ASM_INC_OFFSET_BASE_BYTE_MULTIPLE_RELOAD(offset0, offset1, offset2, offset3, \
+                                                 global, byte0, byte1, byte2, byte3, \
+                                                 src, srcOffset)        \
+    __asm volatile (                                                    \
+                    "shl $2, %0\n"                                      \
+                    "incl " TLS_ADDR(global, "%c4", "%0") "\n"             \
+                    "movzbl %c9+0(%8), %k0\n"                           \
+                    "shl $2, %1\n"                                      \
+                    "incl " TLS_ADDR(global, "%c5", "%1") "\n"             \
+                    "movzbl %c9+1(%8), %k1\n"                           \
+                    "shl $2, %2\n"                                      \
+                    "incl " TLS_ADDR(global, "%c6", "%2") "\n"             \
+                    "movzbl %c9+2(%8), %k2\n"                           \
+                    "shl $2, %3\n"                                      \
+                    "incl " TLS_ADDR(global, "%c7", "%3") "\n"             \
+                    "movzbl %c9+3(%8), %k3\n":                          \
+                    "+&r" (byte0),  /* read and write */                 \
+                    "+&r" (byte1),  /* read and write */                 \
+                    "+&r" (byte2),  /* read and write */                \
+                    "+&r" (byte3):  /* read and write */                \
+                    "i" (offset0),                                      \
+                    "i" (offset1),                                      \
+                    "i" (offset2),                                      \
+                    "i" (offset3),                                      \
+                    "r" (src),                                          \
+                    "i" (srcOffset)                                     \
+                    TLS_OPERAND(global):                                \
+                    "memory" /* clobbers */                             \
+                                                                        )
+
+int count8reload(const uint8_t *src, size_t srcSize, U32 *bin)
+{
+    memset(t_count, 0, sizeof(t_count));
+
+    size_t remainder = srcSize; // initially only
+    if (srcSize < 32) {  // or some small number
+        goto handle_remainder;
+    }
+
+    // preload for first loop iteration
+    uint64_t byte0 = *(src + 0);
+    uint64_t byte1 = *(src + 1);
+    uint64_t byte2 = *(src + 2);
+    uint64_t byte3 = *(src + 3);
+    uint64_t byte4 = *(src + 4);
+    uint64_t byte5 = *(src + 5);
+    uint64_t byte6 = *(src + 6);
+    uint64_t byte7 = *(src + 7);
+    src += 8;
+    srcSize -= 8;
+
+    remainder = srcSize % 16;
+    remainder += 16;  // allow for some safe read-ahead
+    srcSize = srcSize - remainder;
+    const uint8_t *endSrc = src + srcSize;
+
+    IACA_START;
+    while (src < endSrc) {
+        
+        ASM_INC_OFFSET_BASE_BYTE_MULTIPLE_RELOAD(COUNT_SIZE * 4 * 0, COUNT_SIZE * 4 * 1, 
+                                                 COUNT_SIZE * 4 * 2, COUNT_SIZE * 4 * 3,
+                                                 t_count, byte0, byte1, byte2, byte3, 
+                                                 src, 0);
+
+        ASM_INC_OFFSET_BASE_BYTE_MULTIPLE_RELOAD(COUNT_SIZE * 4 * 4, COUNT_SIZE * 4 * 5, 
+                                                 COUNT_SIZE * 4 * 6, COUNT_SIZE * 4 * 7,
+                                                 t_count, byte4, byte5, byte6, byte7, 
+                                                 src, 4);
+
+        ASM_INC_OFFSET_BASE_BYTE_MULTIPLE_RELOAD(COUNT_SIZE * 4 * 8, COUNT_SIZE * 4 * 9, 
+                                                 COUNT_SIZE * 4 * 10, COUNT_SIZE * 4 * 11,
+                                                 t_count, byte0, byte1, byte2, byte3, 
+                                                 src, 8);
+
+        ASM_INC_OFFSET_BASE_BYTE_MULTIPLE_RELOAD(COUNT_SIZE * 4 * 12, COUNT_SIZE * 4 * 13, 
+                                                 COUNT_SIZE * 4 * 14, COUNT_SIZE * 4 * 15,
+                                                 t_count, byte4, byte5, byte6, byte7, 
+                                                 src, 12);
+
+
+
+        src += 16;
+        IACA_END;
+
+    }
+
+
+    src -= 8; // redo last 8 that were preloaded
+    remainder += 8;
+
+ handle_remainder:
+    for (size_t i = 0; i < remainder; i++) {
+        uint64_t byte = src[i];
+        t_count[0][byte]++;
+    }
+
+    // sum 256 byte counters in 16 separate arrays into bin[byte]
+    HIST_reduce(t_count, 16, bin, 0);
+
+    return bin[0];
+}
+
+#define ASM_SHIFT_RIGHT(reg, bitsToShift)                                \
+    __asm volatile ("shr %1, %0":                                       \
+                    "+r" (reg): /* read and written */                  \
+                    "i" (bitsToShift) /* constant */                    \
+                    )
+
+
+#define ASM_INC_TABLES(src0, src1, byte0, byte1, offset, size, base, scale) \
+    __asm volatile ("movzbl %b2, %k0\n"                /* byte0 = src0 & 0xFF */ \
+                    "movzbl %b3, %k1\n"                /* byte1 = src1 & 0xFF */ \
+                    "incl (%c4+0)*%c5(%6, %0, %c7)\n"  /* count[i+0][byte0]++ */ \
+                    "incl (%c4+1)*%c5(%6, %1, %c7)\n"  /* count[i+1][byte1]++ */ \
+                    "movzbl %h2, %k0\n"                /* byte0 = (src0 & 0xFF00) >> 8 */ \
+                    "movzbl %h3, %k1\n"                /* byte1 = (src1 & 0xFF00) >> 8 */ \
+                    "incl (%c4+2)*%c5(%6, %0, %c7)\n"  /* count[i+2][byte0]++ */ \
+                    "incl (%c4+3)*%c5(%6, %1, %c7)\n": /* count[i+3][byte1]++ */ \
+                    "=&R" (byte0),  /* write only (R == non REX) */     \
+                    "=&R" (byte1):  /* write only (R == non REX) */     \
+                    "Q" (src0),  /* read only (Q == must have rH) */    \
+                    "Q" (src1),  /* read only (Q == must have rH) */    \
+                    "i" (offset), /* constant array offset */           \
+                    "i" (size), /* constant array size     */           \
+                    "r" (base),  /* read only array address */          \
+                    "i" (scale):  /* constant [1,2,4,8] */              \
+                    "memory" /* clobbered (forces compiler to compute sum ) */ \
+                    )
+
+int count2x64(const uint8_t *src, size_t srcSize, U32 *bin)
+{
+    memset(t_count, 0, sizeof(t_count));
+
+    U64 remainder = srcSize;
+    if (srcSize < 32) goto handle_remainder;
+
+    remainder = srcSize % 16;
+    remainder += 16;  // next0/next1 read one group ahead
+    srcSize -= remainder;  
+    const BYTE *endSrc = src + srcSize;
+    U64 next0 = *(const U64 *)(src + 0);
+    U64 next1 = *(const U64 *)(src + 8);
+
+    IACA_START;
+
+    while (src != endSrc)
+    {
+        U64 byte0, byte1;
+        U64 data0 = next0;
+        U64 data1 = next1;
+
+        src += 16;
+        next0 = *(const U64 *)(src + 0);
+        next1 = *(const U64 *)(src + 8);
+
+        ASM_INC_TABLES(data0, data1, byte0, byte1, 0, COUNT_SIZE * 4, t_count, 4);
+
+        ASM_SHIFT_RIGHT(data0, 16);
+        ASM_SHIFT_RIGHT(data1, 16);
+        ASM_INC_TABLES(data0, data1, byte0, byte1, 4, COUNT_SIZE * 4, t_count, 4);
+
+        ASM_SHIFT_RIGHT(data0, 16);
+        ASM_SHIFT_RIGHT(data1, 16);
+        ASM_INC_TABLES(data0, data1, byte0, byte1, 8, COUNT_SIZE * 4, t_count, 4);
+
+        ASM_SHIFT_RIGHT(data0, 16);
+        ASM_SHIFT_RIGHT(data1, 16);
+        ASM_INC_TABLES(data0, data1, byte0, byte1, 12, COUNT_SIZE * 4, t_count, 4);
+    }
+
+    IACA_END;
+
+ handle_remainder:
+    for (size_t i = 0; i < remainder; i++) {
+        uint64_t byte = src[i];
+        t_count[0][byte]++;
+    }
+
+    // sum 256 byte counters in 16 separate arrays into bin[byte]
+    HIST_reduce(t_count, 16, bin, 0);
+
+    return bin[0];
+}
+
+
+// hist_X_Y functions from https://github.com/powturbo/turbohist
+
+// Each hist_X_Y body is compiled once per instruction set through
+// HIST_VARIANT() below; the plain names are the baseline variants.
+#define HIST_BODY static inline __attribute__((always_inline))
+
+HIST_BODY int hist_4_32_body(const uint8_t *in, size_t inlen, U32 *bin) { 
+#define NU 16
+    int i;
+    unsigned c0[COUNT_SIZE]={0},c1[COUNT_SIZE]={0},c2[COUNT_SIZE]={0},c3[COUNT_SIZE]={0}; 
+    const unsigned char *ip;
+
+    // stop while the read-ahead of the next word still lies inside in[]
+    const unsigned char *fastEnd = in + (inlen < 4 ? 0 : (inlen - 4) & ~(NU-1));
+    unsigned cp = (fastEnd != in) ? *(const unsigned *)in : 0;
+    for(ip = in; ip != fastEnd;) {
+        unsigned c = cp; ip += 4; cp = *(const unsigned *)ip;
+        c0[(unsigned char)c      ]++;
+        c1[(unsigned char)(c>>8) ]++;
+        c2[(unsigned char)(c>>16)]++;
+        c3[c>>24                 ]++;
+
+        c = cp; ip += 4; cp = *(const unsigned *)ip;
+        c0[(unsigned char)c      ]++;
+        c1[(unsigned char)(c>>8) ]++;
+        c2[(unsigned char)(c>>16)]++;
+        c3[c>>24                 ]++;
+
+        c = cp; ip += 4; cp = *(const unsigned *)ip;
+        c0[(unsigned char)c      ]++;
+        c1[(unsigned char)(c>>8) ]++;
+        c2[(unsigned char)(c>>16)]++;
+        c3[c>>24                 ]++;
+
+        c = cp; ip += 4; cp = *(const unsigned *)ip;
+        c0[(unsigned char)c      ]++;
+        c1[(unsigned char)(c>>8) ]++;
+        c2[(unsigned char)(c>>16)]++;
+        c3[c>>24                 ]++;
+    }
+    while(ip < in+inlen) c0[*ip++]++; 
+    for(i = 0; i < 256; i++) 
+        bin[i] = c0[i]+c1[i]+c2[i]+c3[i];
+
+    return bin[0];
+#undef NU
+}
+
+HIST_BODY int hist_4_64_body(const uint8_t *in, size_t inlen, U32 *bin) { 
+    int i;
+    unsigned c0[COUNT_SIZE]={0},c1[COUNT_SIZE]={0},c2[COUNT_SIZE]={0},c3[COUNT_SIZE]={0}; 
+    const unsigned char *ip;
+
+    // stop while the read-ahead of the next word still lies inside in[]
+    const unsigned char *fastEnd = in + (inlen < 8 ? 0 : (inlen - 8) & ~(16-1));
+    unsigned long long cp = (fastEnd != in) ? *(const unsigned long long *)in : 0;
+    for(ip = in; ip != fastEnd; ) {    
+        unsigned long long c = cp; ip += 8; cp = *(const unsigned long long *)ip; 
+        c0[(unsigned char) c     ]++;
+        c1[(unsigned char)(c>> 8)]++;
+        c2[(unsigned char)(c>>16)]++;
+        c3[(unsigned char)(c>>24)]++;
+        c0[(unsigned char)(c>>32)]++;
+        c1[(unsigned char)(c>>40)]++;
+        c2[(unsigned char)(c>>48)]++;
+        c3[                c>>56 ]++;
+
+        c = cp; ip += 8; cp = *(const unsigned long long *)ip; 
+        c0[(unsigned char) c    ]++;
+        c1[(unsigned char)(c>> 8)]++;
+        c2[(unsigned char)(c>>16)]++;
+        c3[(unsigned char)(c>>24)]++;
+        c0[(unsigned char)(c>>32)]++;
+        c1[(unsigned char)(c>>40)]++;
+        c2[(unsigned char)(c>>48)]++;
+        c3[                c>>56 ]++;
+    }
+    while(ip < in+inlen) c0[*ip++]++; 
+    for(i = 0; i < 256; i++) 
+        bin[i] = c0[i]+c1[i]+c2[i]+c3[i];
+
+    return bin[0];
+}
+
+HIST_BODY int hist_8_64_body(const uint8_t *in, size_t inlen, U32 *bin) { 
+    int i;
+    unsigned c0[COUNT_SIZE]={0},c1[COUNT_SIZE]={0},c2[COUNT_SIZE]={0},c3[COUNT_SIZE]={0},c4[COUNT_SIZE]={0},c5[COUNT_SIZE]={0},c6[COUNT_SIZE]={0},c7[COUNT_SIZE]={0}; 
+    const unsigned char *ip;
+
+    // stop while the read-ahead of the next word still lies inside in[]
+    const unsigned char *fastEnd = in + (inlen < 8 ? 0 : (inlen - 8) & ~(16-1));
+    unsigned long long cp = (fastEnd != in) ? *(const unsigned long long *)in : 0;
+    for(ip = in; ip != fastEnd; ) {    
+        unsigned long long c = cp; ip += 8; cp = *(const unsigned long long *)ip; 
+        c0[(unsigned char) c     ]++;
+        c1[(unsigned char)(c>>8) ]++;
+        c2[(unsigned char)(c>>16)]++;
+        c3[(unsigned char)(c>>24)]++;
+        c4[(unsigned char)(c>>32)]++;
+        c5[(unsigned char)(c>>40)]++;
+        c6[(unsigned char)(c>>48)]++;
+        c7[c>>56]++;
+
+        c = cp;  ip += 8; cp = *(const unsigned long long *)ip; 
+        c0[(unsigned char) c     ]++;
+        c1[(unsigned char)(c>>8) ]++;
+        c2[(unsigned char)(c>>16)]++;
+        c3[(unsigned char)(c>>24)]++;
+        c4[(unsigned char)(c>>32)]++;
+        c5[(unsigned char)(c>>40)]++;
+        c6[(unsigned char)(c>>48)]++;
+        c7[                c>>56]++;
+    }
+    while(ip < in+inlen) c0[*ip++]++; 
+    for(i = 0; i < 256; i++) 
+        bin[i] = c0[i]+c1[i]+c2[i]+c3[i]+c4[i]+c5[i]+c6[i]+c7[i];
+
+    return bin[0];
+}
+
+
+HIST_BODY __attribute__((target("sse4.1")))
+int hist_4_128_body(const uint8_t *in, size_t inlen, U32 *bin) { 
+    int i;
+    unsigned c0[COUNT_SIZE]={0},c1[COUNT_SIZE]={0},c2[COUNT_SIZE]={0},c3[COUNT_SIZE]={0}; 
+    const unsigned char *ip;
+
+    // stop while the read-ahead of the next vector still lies inside in[]
+    const unsigned char *fastEnd = in + (inlen < 16 ? 0 : (inlen - 16) & ~(16-1));
+    __m128i vcp = (fastEnd != in) ? _mm_loadu_si128((const __m128i*)in) : _mm_setzero_si128();
+    for(ip = in; ip != fastEnd; ) {
+        __m128i vc=vcp; ip += 16; vcp = _mm_loadu_si128((const __m128i*)ip);
+        c0[_mm_extract_epi8(vc,  0)]++;
+        c1[_mm_extract_epi8(vc,  1)]++;
+        c2[_mm_extract_epi8(vc,  2)]++;
+        c3[_mm_extract_epi8(vc,  3)]++;
+        c0[_mm_extract_epi8(vc,  4)]++;
+        c1[_mm_extract_epi8(vc,  5)]++;
+        c2[_mm_extract_epi8(vc,  6)]++;
+        c3[_mm_extract_epi8(vc,  7)]++;
+        c0[_mm_extract_epi8(vc,  8)]++;
+        c1[_mm_extract_epi8(vc,  9)]++;
+        c2[_mm_extract_epi8(vc, 10)]++;
+        c3[_mm_extract_epi8(vc, 11)]++;
+        c0[_mm_extract_epi8(vc, 12)]++;
+        c1[_mm_extract_epi8(vc, 13)]++;
+        c2[_mm_extract_epi8(vc, 14)]++;
+        c3[_mm_extract_epi8(vc, 15)]++;
+    }
+    while(ip < in+inlen) 
+        c0[*ip++]++; 
+    for(i = 0; i < 256; i++) 
+        bin[i] = c0[i]+c1[i]+c2[i]+c3[i];
+
+    return bin[0];
+}
+
+HIST_BODY __attribute__((target("sse4.1")))
+int hist_8_128_body(const uint8_t *in, size_t inlen, U32 *bin) { 
+    int i;
+    unsigned c0[COUNT_SIZE]={0},c1[COUNT_SIZE]={0},c2[COUNT_SIZE]={0},c3[COUNT_SIZE]={0},c4[COUNT_SIZE]={0},c5[COUNT_SIZE]={0},c6[COUNT_SIZE]={0},c7[COUNT_SIZE]={0}; 
+    const unsigned char *ip;
+
+    // stop while the read-ahead of the next vector still lies inside in[]
+    const unsigned char *fastEnd = in + (inlen < 16 ? 0 : (inlen - 16) & ~(16-1));
+    __m128i vcp = (fastEnd != in) ? _mm_loadu_si128((const __m128i*)in) : _mm_setzero_si128();
+    for(ip = in; ip != fastEnd; ) {
+        __m128i vc=vcp; ip += 16; vcp = _mm_loadu_si128((const __m128i*)ip);
+        c0[_mm_extract_epi8(vc,  0)]++;
+        c1[_mm_extract_epi8(vc,  1)]++;
+        c2[_mm_extract_epi8(vc,  2)]++;
+        c3[_mm_extract_epi8(vc,  3)]++;
+        c4[_mm_extract_epi8(vc,  4)]++;
+        c5[_mm_extract_epi8(vc,  5)]++;
+        c6[_mm_extract_epi8(vc,  6)]++;
+        c7[_mm_extract_epi8(vc,  7)]++;
+        c0[_mm_extract_epi8(vc,  8)]++;
+        c1[_mm_extract_epi8(vc,  9)]++;
+        c2[_mm_extract_epi8(vc, 10)]++;
+        c3[_mm_extract_epi8(vc, 11)]++;
+        c4[_mm_extract_epi8(vc, 12)]++;
+        c5[_mm_extract_epi8(vc, 13)]++;
+        c6[_mm_extract_epi8(vc, 14)]++;
+        c7[_mm_extract_epi8(vc, 15)]++;
+    }
+    while(ip < in+inlen) c0[*ip++]++; 
+    for(i = 0; i < 256; i++) 
+        bin[i] = c0[i]+c1[i]+c2[i]+c3[i]+c4[i]+c5[i]+c6[i]+c7[i];
+
+    return bin[0];
+}
+
+
+
+// Define kernel name##suffix from name##_body, compiled for target isa
+#define HIST_VARIANT(name, suffix, isa)                                 \
+    __attribute__((target(isa)))                                        \
+    int name##suffix(const uint8_t *in, size_t inlen, U32 *bin)         \
+    {                                                                   \
+        return name##_body(in, inlen, bin);                             \
+    }
+
+int hist_4_32(const uint8_t *in, size_t inlen, U32 *bin) { return hist_4_32_body(in, inlen, bin); }
+int hist_4_64(const uint8_t *in, size_t inlen, U32 *bin) { return hist_4_64_body(in, inlen, bin); }
+int hist_8_64(const uint8_t *in, size_t inlen, U32 *bin) { return hist_8_64_body(in, inlen, bin); }
+HIST_VARIANT(hist_4_128, , "sse4.1")
+HIST_VARIANT(hist_8_128, , "sse4.1")
+
+// BMI2 gives the 64-bit kernels non-destructive shifts (shrx)
+static HIST_VARIANT(hist_4_32, _avx2, "avx2,bmi2")
+static HIST_VARIANT(hist_4_64, _avx2, "avx2,bmi2")
+static HIST_VARIANT(hist_8_64, _avx2, "avx2,bmi2")
+static HIST_VARIANT(hist_4_128, _avx2, "avx2,bmi2")
+static HIST_VARIANT(hist_8_128, _avx2, "avx2,bmi2")
+
+
+// Compressed sub-counters: the 16 sub-tables hold U8 (4 KB) or U16 (8 KB)
+// counters instead of 17 KB of U32, leaving L1 to the input and to more
+// tables.  Byte k of each 16-byte group always goes to table k, so a
+// counter gains at most one per group; every SUB8_GROUPS (SUB16_GROUPS)
+// groups, before any counter can wrap, the tables are widened into U32
+// totals and cleared, with SSE2 unpacks.
+
+#define SUB_SIZE (HIST_SYMBOLS + 16)  // padded against 4K aliasing, as COUNT_SIZE
+#define SUB8_GROUPS 255
+#define SUB16_GROUPS 65535
+
+static __thread BYTE t_sub8[16][SUB_SIZE] __attribute__((aligned(64)));
+static __thread U16 t_sub16[16][SUB_SIZE] __attribute__((aligned(64)));
+
+// low and high byte of each 16-bit step, so the compiler can use %ah-style
+// byte registers and needs one shift per two bytes, as in count2x64
+#define SUB_INC_PAIR(table, word, first)                \
+    do {                                                \
+        table[first    ][(BYTE)(word)     ]++;          \
+        table[first + 1][(BYTE)(word >> 8)]++;          \
+        word >>= 16;                                    \
+    } while (0)
+
+#define SUB_INC_WORD(table, word, first)        \
+    do {                                        \
+        SUB_INC_PAIR(table, word, first);       \
+        SUB_INC_PAIR(table, word, first + 2);   \
+        SUB_INC_PAIR(table, word, first + 4);   \
+        SUB_INC_PAIR(table, word, first + 6);   \
+    } while (0)
+
+// Add the U8 tables into bin[] and clear them in the same pass.  16 x 255
+// fits a U16, so the tables are summed in registers 16 bins at a time.
+HIST_BODY void hist_widen8(U32 *bin)
+{
+    const xmm_t zero = _mm_setzero_si128();
+    for (int b = 0; b < HIST_SYMBOLS; b += 16) {
+        xmm_t lo = zero, hi = zero;
+        for (int t = 0; t < 16; t++) {
+            xmm_t sub = _mm_load_si128((const xmm_t *)&t_sub8[t][b]);
+            _mm_store_si128((xmm_t *)&t_sub8[t][b], zero);
+            lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(sub, zero));
+            hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(sub, zero));
+        }
+        xmm_t *out = (xmm_t *)(bin + b);
+        _mm_storeu_si128(out + 0, _mm_add_epi32(_mm_loadu_si128(out + 0), _mm_unpacklo_epi16(lo, zero)));
+        _mm_storeu_si128(out + 1, _mm_add_epi32(_mm_loadu_si128(out + 1), _mm_unpackhi_epi16(lo, zero)));
+        _mm_storeu_si128(out + 2, _mm_add_epi32(_mm_loadu_si128(out + 2), _mm_unpacklo_epi16(hi, zero)));
+        _mm_storeu_si128(out + 3, _mm_add_epi32(_mm_loadu_si128(out + 3), _mm_unpackhi_epi16(hi, zero)));
+    }
+}
+
+// Same for the U16 tables, which can't be summed in U16: each table is
+// widened to U32 on its own, 8 bins at a time.
+HIST_BODY void hist_widen16(U32 *bin)
+{
+    const xmm_t zero = _mm_setzero_si128();
+    for (int b = 0; b < HIST_SYMBOLS; b += 8) {
+        xmm_t lo = zero, hi = zero;
+        for (int t = 0; t < 16; t++) {
+            xmm_t sub = _mm_load_si128((const xmm_t *)&t_sub16[t][b]);
+            _mm_store_si128((xmm_t *)&t_sub16[t][b], zero);
+            lo = _mm_add_epi32(lo, _mm_unpacklo_epi16(sub, zero));
+            hi = _mm_add_epi32(hi, _mm_unpackhi_epi16(sub, zero));
+        }
+        xmm_t *out = (xmm_t *)(bin + b);
+        _mm_storeu_si128(out + 0, _mm_add_epi32(_mm_loadu_si128(out + 0), lo));
+        _mm_storeu_si128(out + 1, _mm_add_epi32(_mm_loadu_si128(out + 1), hi));
+    }
+}
+
+HIST_BODY int hist_16_64_u8_body(const uint8_t *in, size_t inlen, U32 *bin) {
+    size_t nbGroups = inlen / 16;
+    const BYTE *ip = in;
+
+    memset(bin, 0, HIST_SYMBOLS * sizeof(*bin));
+    memset(t_sub8, 0, sizeof(t_sub8));
+    while (nbGroups) {
+        size_t n = nbGroups < SUB8_GROUPS ? nbGroups : SUB8_GROUPS;
+        nbGroups -= n;
+        for (; n; n--, ip += 16) {
+            U64 c = *(const U64 *)ip;
+            U64 d = *(const U64 *)(ip + 8);
+            SUB_INC_WORD(t_sub8, c, 0);
+            SUB_INC_WORD(t_sub8, d, 8);
+        }
+        hist_widen8(bin);
+    }
+    while (ip < in + inlen) bin[*ip++]++;
+
+    return bin[0];
+}
+
+HIST_BODY int hist_16_64_u16_body(const uint8_t *in, size_t inlen, U32 *bin) {
+    size_t nbGroups = inlen / 16;
+    const BYTE *ip = in;
+
+    memset(bin, 0, HIST_SYMBOLS * sizeof(*bin));
+    memset(t_sub16, 0, sizeof(t_sub16));
+    while (nbGroups) {
+        size_t n = nbGroups < SUB16_GROUPS ? nbGroups : SUB16_GROUPS;
+        nbGroups -= n;
+        for (; n; n--, ip += 16) {
+            U64 c = *(const U64 *)ip;
+            U64 d = *(const U64 *)(ip + 8);
+            SUB_INC_WORD(t_sub16, c, 0);
+            SUB_INC_WORD(t_sub16, d, 8);
+        }
+        hist_widen16(bin);
+    }
+    while (ip < in + inlen) bin[*ip++]++;
+
+    return bin[0];
+}
+
+int hist_16_64_u8(const uint8_t *in, size_t inlen, U32 *bin) { return hist_16_64_u8_body(in, inlen, bin); }
+int hist_16_64_u16(const uint8_t *in, size_t inlen, U32 *bin) { return hist_16_64_u16_body(in, inlen, bin); }
+static HIST_VARIANT(hist_16_64_u8, _avx2, "avx2,bmi2")
+static HIST_VARIANT(hist_16_64_u16, _avx2, "avx2,bmi2")
+
+
+// Skewed data: compare 32 bytes at a time against a broadcast of the
+// current hot byte (the last byte seen when matches were scarce) and add
+// the number of matches in one go; only the other bytes are counted one by
+// one, from the movemask bits, round robin over 4 tables.  Constant runs
+// cost one compare per 32 bytes, and at -P90 most bytes never touch memory.
+// Every RUN_PROBE bytes the match rate is checked: below one half, the next
+// RUN_FALLBACK bytes go through plain 16-table counting instead.
+#define RUN_PROBE 256
+#define RUN_FALLBACK (16 << 10)
+
+__attribute__((target("avx2,bmi,popcnt")))
+int count_runs(const uint8_t *src, size_t srcSize, U32 *bin)
+{
+    size_t i = 0;
+    BYTE hot = srcSize ? src[0] : 0;
+    U32 hotCount = 0;
+
+    memset(t_count, 0, sizeof(t_count));
+
+    while (i + RUN_PROBE <= srcSize) {
+        const size_t probeEnd = i + RUN_PROBE;
+        U32 matched = 0;
+        for (; i < probeEnd; i += 32) {
+            ymm_t vec = _mm256_loadu_si256((const ymm_t *)(src + i));
+            U32 same = (U32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(vec, _mm256_set1_epi8((char)hot)));
+            U32 diff = ~same;
+            U32 nbSame = (U32)__builtin_popcount(same);
+            hotCount += nbSame;
+            matched += nbSame;
+            while (diff) {
+                U32 k = (U32)__builtin_ctz(diff);
+                t_count[k & 3][src[i + k]]++;
+                diff = _blsr_u32(diff);
+            }
+            if (nbSame < 16) {
+                t_count[0][hot] += hotCount;
+                hotCount = 0;
+                hot = src[i + 31];
+            }
+        }
+
+        if (matched < RUN_PROBE / 2) {
+            // high entropy: the compare only adds work, count normally
+            size_t fallbackEnd = i + RUN_FALLBACK < srcSize ? i + RUN_FALLBACK : srcSize;
+            for (; i + 16 <= fallbackEnd; i += 16) {
+                U64 c = *(const U64 *)(src + i);
+                U64 d = *(const U64 *)(src + i + 8);
+                SUB_INC_WORD(t_count, c, 0);
+                SUB_INC_WORD(t_count, d, 8);
+            }
+        }
+    }
+    t_count[0][hot] += hotCount;
+    for (; i < srcSize; i++) t_count[0][src[i]]++;
+
+    // sum 256 byte counters in 16 separate arrays into bin[byte]
+    HIST_reduce(t_count, 16, bin, 0);
+
+    return bin[0];
+}
+
+
+// Vertical counters, fully in registers: each pass over a block compares
+// every 32-byte vector against VERT_GROUP broadcast symbols and subtracts
+// the 0xFF matches from per-lane U8 counters, then psadbw sums the lanes.
+// No table is stored to, but the work grows with the alphabet, so it
+// takes the largest symbol value as a bound: bytes above maxSymbol are
+// not counted at all (HIST_countHint() checks the total and recounts).
+#define VERT_GROUP 8             // symbols per pass, one accumulator each
+#define VERT_BLOCK (255 * 32)    // U8 lane counters would wrap after 255 vectors
+
+__attribute__((target("avx2")))
+int count_vertical(const uint8_t *src, size_t srcSize, U32 *bin, unsigned maxSymbol)
+{
+    const size_t vecEnd = srcSize & ~(size_t)31;
+    const unsigned nbSymbols = (maxSymbol > 255 ? 255 : maxSymbol) + 1;
+    size_t i;
+
+    memset(bin, 0, HIST_SYMBOLS * sizeof(*bin));
+
+    for (size_t blockStart = 0; blockStart < vecEnd; blockStart += VERT_BLOCK) {
+        const size_t blockEnd = blockStart + VERT_BLOCK < vecEnd ? blockStart + VERT_BLOCK : vecEnd;
+        for (unsigned s0 = 0; s0 < nbSymbols; s0 += VERT_GROUP) {
+            ymm_t acc[VERT_GROUP], sym[VERT_GROUP];
+            for (int g = 0; g < VERT_GROUP; g++) {
+                acc[g] = _mm256_setzero_si256();
+                sym[g] = _mm256_set1_epi8((char)(s0 + g));
+            }
+            for (i = blockStart; i < blockEnd; i += 32) {
+                ymm_t vec = _mm256_loadu_si256((const ymm_t *)(src + i));
+                for (int g = 0; g < VERT_GROUP; g++)
+                    acc[g] = _mm256_sub_epi8(acc[g], _mm256_cmpeq_epi8(vec, sym[g]));
+            }
+            for (int g = 0; g < VERT_GROUP && s0 + g < nbSymbols; g++) {
+                ymm_t sad = _mm256_sad_epu8(acc[g], _mm256_setzero_si256());
+                xmm_t sum = _mm_add_epi64(_mm256_castsi256_si128(sad), _mm256_extracti128_si256(sad, 1));
+                bin[s0 + g] += (U32)(_mm_cvtsi128_si64(sum) + _mm_extract_epi64(sum, 1));
+            }
+        }
+    }
+    for (i = vecEnd; i < srcSize; i++) {
+        if (src[i] < nbSymbols) bin[src[i]]++;
+    }
+
+    return bin[0];
+}
+
+
+// Runtime dispatch: every compiled variant, best first within the whole
+// table and within each family.  The CPU is probed with cpuid (through
+// __builtin_cpu_supports) once, at startup, and HIST_count() then uses
+// the first variant the CPU can run.
+
+static const HIST_variant_t g_variants[] = {
+    { "port7vec",     HIST_ISA_AVX2,    port7vec },
+    { "count2x64",    HIST_ISA_GENERIC, count2x64 },
+    { "scatter512",   HIST_ISA_AVX512,  scatter512 },
+    { "hist_8_64",    HIST_ISA_AVX2,    hist_8_64_avx2 },
+    { "hist_8_64",    HIST_ISA_GENERIC, hist_8_64 },
+    { "hist_16_64_u16", HIST_ISA_AVX2,  hist_16_64_u16_avx2 },
+    { "hist_16_64_u16", HIST_ISA_GENERIC, hist_16_64_u16 },
+    { "hist_16_64_u8", HIST_ISA_AVX2,   hist_16_64_u8_avx2 },
+    { "hist_16_64_u8", HIST_ISA_GENERIC, hist_16_64_u8 },
+    { "count_runs",   HIST_ISA_AVX2,    count_runs },
+    { "hist_4_64",    HIST_ISA_AVX2,    hist_4_64_avx2 },
+    { "hist_4_64",    HIST_ISA_GENERIC, hist_4_64 },
+    { "hist_4_32",    HIST_ISA_AVX2,    hist_4_32_avx2 },
+    { "hist_4_32",    HIST_ISA_GENERIC, hist_4_32 },
+    { "hist_8_128",   HIST_ISA_AVX2,    hist_8_128_avx2 },
+    { "hist_8_128",   HIST_ISA_SSE41,   hist_8_128 },
+    { "hist_4_128",   HIST_ISA_AVX2,    hist_4_128_avx2 },
+    { "hist_4_128",   HIST_ISA_SSE41,   hist_4_128 },
+    { "count8reload", HIST_ISA_GENERIC, count8reload },
+    { "count_vec",    HIST_ISA_SSE41,   count_vec },
+    { "storePort7",   HIST_ISA_GENERIC, storePort7 },
+    { "reloadPort7",  HIST_ISA_GENERIC, reloadPort7 },
+    { "vecavx",       HIST_ISA_AVX,     vecavx },
+    { "trivialCount", HIST_ISA_GENERIC, trivialCount },
+};
+#define NB_VARIANTS (sizeof(g_variants) / sizeof(*g_variants))
+
+const char *HIST_isaName(HIST_isa_t isa)
+{
+    switch (isa) {
+    case HIST_ISA_GENERIC: return "generic";
+    case HIST_ISA_SSE41:   return "sse4.1";
+    case HIST_ISA_AVX:     return "avx";
+    case HIST_ISA_AVX2:    return "avx2";
+    case HIST_ISA_AVX512:  return "avx512";
+    }
+    return "unknown";
+}
+
+int HIST_isaSupported(HIST_isa_t isa)
+{
+    __builtin_cpu_init();
+    switch (isa) {
+    case HIST_ISA_GENERIC: return 1;
+    case HIST_ISA_SSE41:   return __builtin_cpu_supports("sse4.1");
+    case HIST_ISA_AVX:     return __builtin_cpu_supports("avx");
+    case HIST_ISA_AVX2:    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi")
+                                  && __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("popcnt");
+    case HIST_ISA_AVX512:  return __builtin_cpu_supports("avx512f");
+    }
+    return 0;
+}
+
+const HIST_variant_t *HIST_variants(size_t *nbVariants)
+{
+    *nbVariants = NB_VARIANTS;
+    return g_variants;
+}
+
+const HIST_variant_t *HIST_findVariant(const char *name, const char *isaName)
+{
+    for (size_t v = 0; v < NB_VARIANTS; v++) {
+        if (!strcmp(g_variants[v].name, name) && !strcmp(HIST_isaName(g_variants[v].isa), isaName))
+            return &g_variants[v];
+    }
+    return NULL;
+}
+
+
+// Tuning: block size thresholds measured by countbench --autotune.  Each
+// line of the file is "maxBlockSize kernel isa", with maxBlockSize 0
+// meaning any larger size; lines are sorted on load, so a hand edited
+// file may list them in any order.  Lines naming a variant this
+// build lacks or this CPU cannot run are skipped, so a file from another
+// host degrades to the static choice rather than failing.
+
+#define HIST_MAX_TUNING 32
+
+typedef struct {
+    size_t maxSize;
+    const HIST_variant_t *variant;
+} HIST_tuning_t;
+
+static HIST_tuning_t g_tuning[HIST_MAX_TUNING];
+static size_t g_nbTuning;
+
+// ascending maxSize, with 0 (any larger) last
+static int HIST_compareTuning(const void *a, const void *b)
+{
+    size_t x = ((const HIST_tuning_t *)a)->maxSize - 1;  // 0 wraps to SIZE_MAX
+    size_t y = ((const HIST_tuning_t *)b)->maxSize - 1;
+    return (x > y) - (x < y);
+}
+
+int HIST_loadTuning(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) return -1;
+
+    char line[256];
+    size_t nbTuning = 0;
+    while (nbTuning < HIST_MAX_TUNING && fgets(line, sizeof(line), file)) {
+        unsigned long long maxSize;
+        char name[64], isaName[16];
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%llu %63s %15s", &maxSize, name, isaName) != 3) continue;
+
+        const HIST_variant_t *variant = HIST_findVariant(name, isaName);
+        if (!variant || !HIST_isaSupported(variant->isa)) continue;
+        g_tuning[nbTuning].maxSize = (size_t)maxSize;
+        g_tuning[nbTuning].variant = variant;
+        nbTuning++;
+    }
+    fclose(file);
+
+    qsort(g_tuning, nbTuning, sizeof(*g_tuning), HIST_compareTuning);
+    g_nbTuning = nbTuning;
+    return (int)nbTuning;
+}
+
+static const HIST_variant_t *g_selected;
+static pthread_once_t g_dispatchOnce = PTHREAD_ONCE_INIT;
+
+static void HIST_initDispatch(void)
+{
+    for (size_t v = 0; v < NB_VARIANTS; v++) {
+        if (HIST_isaSupported(g_variants[v].isa)) {
+            g_selected = &g_variants[v];
+            break;
+        }
+    }
+
+    const char *tuningPath = getenv("HIST_TUNING");
+    if (tuningPath) HIST_loadTuning(tuningPath);
+}
+
+const HIST_variant_t *HIST_selected(void)
+{
+    pthread_once(&g_dispatchOnce, HIST_initDispatch);
+    return g_selected;
+}
+
+__attribute__((constructor))
+static void HIST_initAtStartup(void)
+{
+    HIST_selected();
+}
+
+HIST_kernel_t HIST_bestVariant(HIST_kernel_t kernel)
+{
+    const char *family = NULL;
+    for (size_t v = 0; v < NB_VARIANTS && !family; v++) {
+        if (g_variants[v].kernel == kernel) family = g_variants[v].name;
+    }
+    if (!family) return kernel;  // not one of ours, nothing to choose from
+
+    for (size_t v = 0; v < NB_VARIANTS; v++) {
+        if (!strcmp(g_variants[v].name, family) && HIST_isaSupported(g_variants[v].isa))
+            return g_variants[v].kernel;
+    }
+    return NULL;
+}
+
+const HIST_variant_t *HIST_tunedVariant(size_t srcSize)
+{
+    const HIST_variant_t *variant = HIST_selected();
+    for (size_t t = 0; t < g_nbTuning; t++) {
+        if (srcSize <= g_tuning[t].maxSize || g_tuning[t].maxSize == 0) {
+            return g_tuning[t].variant;
+        }
+    }
+    return variant;
+}
+
+int HIST_count(const uint8_t *src, size_t srcSize, U32 *count)
+{
+    return HIST_tunedVariant(srcSize)->kernel(src, srcSize, count);
+}
+
+// Below this many symbols the vertical kernel beats table counting
+#define HIST_VERTICAL_MAX 48
+
+int HIST_countHint(const uint8_t *src, size_t srcSize, U32 *count, unsigned maxSymbol)
+{
+    if (maxSymbol < HIST_VERTICAL_MAX && HIST_isaSupported(HIST_ISA_AVX2)) {
+        size_t total = 0;
+        count_vertical(src, srcSize, count, maxSymbol);
+        for (unsigned s = 0; s <= maxSymbol; s++) total += count[s];
+        if (total == srcSize) return (int)count[0];
+        // the hint was wrong: some bytes are above maxSymbol
+    }
+    return HIST_count(src, srcSize, count);
+}
+
+// Bounded counting: only bins 0..maxSymbolValue of the 16 tables are
+// cleared and reduced, so a 64 symbol alphabet touches 4 KB instead of
+// 17 KB.  Bytes above the bound still land inside the padded rows, and
+// show up as a total short of srcSize.
+size_t HIST_countLimited(const uint8_t *src, size_t srcSize, U32 *count, unsigned *maxSymbolValuePtr)
+{
+    const unsigned nbSymbols = (*maxSymbolValuePtr > 255 ? 255 : *maxSymbolValuePtr) + 1;
+    size_t total = 0, maxCount = 0;
+    unsigned maxSymbol = 0;
+
+    if (nbSymbols <= HIST_VERTICAL_MAX && HIST_isaSupported(HIST_ISA_AVX2)) {
+        U32 wide[HIST_SYMBOLS];
+        count_vertical(src, srcSize, wide, nbSymbols - 1);
+        memcpy(count, wide, nbSymbols * sizeof(*count));
+    } else {
+        size_t i = 0;
+        for (int t = 0; t < 16; t++) memset(t_count[t], 0, nbSymbols * sizeof(U32));
+        for (; i + 16 <= srcSize; i += 16) {
+            U64 c = *(const U64 *)(src + i);
+            U64 d = *(const U64 *)(src + i + 8);
+            SUB_INC_WORD(t_count, c, 0);
+            SUB_INC_WORD(t_count, d, 8);
+        }
+        // a byte above the bound in the tail would go past count[]
+        for (; i < srcSize; i++) {
+            if (src[i] < nbSymbols) t_count[0][src[i]]++;
+        }
+        // whole 32-bin chunks; the bins past nbSymbols are left out
+        U32 sum[HIST_SYMBOLS];
+        HIST_reduceBins(t_count, 16, (nbSymbols + 31) & ~31U, sum, 0);
+        memcpy(count, sum, nbSymbols * sizeof(*count));
+    }
+
+    for (unsigned s = 0; s < nbSymbols; s++) {
+        total += count[s];
+        if (count[s]) maxSymbol = s;
+        if (count[s] > maxCount) maxCount = count[s];
+    }
+    if (total != srcSize) return HIST_ERROR;  // src has bytes above the bound
+
+    *maxSymbolValuePtr = maxSymbol;
+    return maxCount;
+}
+
+// Batches: HIST_BATCH_WAY streams are counted in one loop, each into its
+// own 4 of the 16 tables, 8 bytes per stream per iteration.  The streams'
+// increments are independent, so each hides the others' store forwarding
+// latency the way hist_8_64's 8 tables do within one stream.  The loop
+// runs to the shortest stream of the group; the rest of each stream, and
+// any final group of fewer streams, goes through the same 4 tables alone.
+#define HIST_BATCH_WAY 4
+
+#define BATCH_INC_WORD(table, word)                     \
+    do {                                                \
+        table[0][(BYTE)(word)      ]++;                 \
+        table[1][(BYTE)(word >> 8) ]++;                 \
+        table[2][(BYTE)(word >> 16)]++;                 \
+        table[3][(BYTE)(word >> 24)]++;                 \
+        table[0][(BYTE)(word >> 32)]++;                 \
+        table[1][(BYTE)(word >> 40)]++;                 \
+        table[2][(BYTE)(word >> 48)]++;                 \
+        table[3][        word >> 56 ]++;                \
+    } while (0)
+
+static void HIST_countWay(const HIST_job_t *jobs, size_t nbWay)
+{
+    U32 (*tables[HIST_BATCH_WAY])[COUNT_SIZE];
+    size_t common = nbWay == HIST_BATCH_WAY ? SIZE_MAX : 0;
+
+    for (size_t j = 0; j < nbWay; j++) {
+        tables[j] = t_count + 4 * j;
+        memset(tables[j], 0, 4 * sizeof(t_count[0]));
+        if (jobs[j].srcSize < common) common = jobs[j].srcSize;
+    }
+    common &= ~(size_t)7;
+
+    for (size_t i = 0; i < common; i += 8) {
+        U64 word0 = *(const U64 *)(jobs[0].src + i);
+        U64 word1 = *(const U64 *)(jobs[1].src + i);
+        U64 word2 = *(const U64 *)(jobs[2].src + i);
+        U64 word3 = *(const U64 *)(jobs[3].src + i);
+        BATCH_INC_WORD(tables[0], word0);
+        BATCH_INC_WORD(tables[1], word1);
+        BATCH_INC_WORD(tables[2], word2);
+        BATCH_INC_WORD(tables[3], word3);
+    }
+
+    for (size_t j = 0; j < nbWay; j++) {
+        const BYTE *ip = jobs[j].src + common;
+        const BYTE *const end = jobs[j].src + jobs[j].srcSize;
+        for (; end - ip >= 8; ip += 8) {
+            U64 word = *(const U64 *)ip;
+            BATCH_INC_WORD(tables[j], word);
+        }
+        while (ip < end) tables[j][0][*ip++]++;
+
+        HIST_reduce(tables[j], 4, jobs[j].count, 0);
+    }
+}
+
+int HIST_countBatch(const HIST_job_t *jobs, size_t nbJobs)
+{
+    for (size_t j = 0; j < nbJobs; j += HIST_BATCH_WAY)
+        HIST_countWay(jobs + j, nbJobs - j < HIST_BATCH_WAY ? nbJobs - j : HIST_BATCH_WAY);
+    return nbJobs ? (int)jobs[0].count[0] : 0;
+}
+
+
+// Streaming: count2x64's inner loop over whole 16-byte groups, minus the
+// read-ahead, counting into the tables of a HIST_stream_t.  Tables are
+// cleared once in HIST_streamInit(), partial groups wait in stream->tail
+// for the next update, and the 16-way reduction is left to finalize.
+
+static void count2x64_accumulate(const BYTE *src, size_t srcSize, U32 (*count)[COUNT_SIZE])
+{
+    const BYTE *endSrc = src + srcSize;  // srcSize is a multiple of 16
+
+    while (src != endSrc)
+    {
+        U64 byte0, byte1;
+        U64 data0 = *(const U64 *)(src + 0);
+        U64 data1 = *(const U64 *)(src + 8);
+        src += 16;
+
+        ASM_INC_TABLES(data0, data1, byte0, byte1, 0, COUNT_SIZE * 4, count, 4);
+
+        ASM_SHIFT_RIGHT(data0, 16);
+        ASM_SHIFT_RIGHT(data1, 16);
+        ASM_INC_TABLES(data0, data1, byte0, byte1, 4, COUNT_SIZE * 4, count, 4);
+
+        ASM_SHIFT_RIGHT(data0, 16);
+        ASM_SHIFT_RIGHT(data1, 16);
+        ASM_INC_TABLES(data0, data1, byte0, byte1, 8, COUNT_SIZE * 4, count, 4);
+
+        ASM_SHIFT_RIGHT(data0, 16);
+        ASM_SHIFT_RIGHT(data1, 16);
+        ASM_INC_TABLES(data0, data1, byte0, byte1, 12, COUNT_SIZE * 4, count, 4);
+    }
+}
+
+// move the sub-tables into the 64-bit totals before any entry could wrap
+static void HIST_streamFlush(HIST_stream_t *stream)
+{
+    HIST_reduce64((U32 (*)[COUNT_SIZE])stream->table, 16, stream->total);
+    memset(stream->table, 0, sizeof(stream->table));
+    stream->sinceFlush = 0;
+}
+
+static void HIST_streamAccumulate(HIST_stream_t *stream, const BYTE *src, size_t srcSize)
+{
+    while (srcSize) {
+        size_t bulk = srcSize < HIST_FLUSH_SIZE ? srcSize : HIST_FLUSH_SIZE;
+        count2x64_accumulate(src, bulk, stream->table);
+        src += bulk;
+        srcSize -= bulk;
+        stream->sinceFlush += bulk;
+        if (stream->sinceFlush >= HIST_FLUSH_SIZE) HIST_streamFlush(stream);
+    }
+}
+
+void HIST_streamInit(HIST_stream_t *stream)
+{
+    memset(stream, 0, sizeof(*stream));
+}
+
+void HIST_streamUpdate(HIST_stream_t *stream, const uint8_t *src, size_t srcSize)
+{
+    const size_t groupSize = sizeof(stream->tail);
+
+    // complete the group left over from the previous update
+    if (stream->tailSize) {
+        size_t fill = groupSize - stream->tailSize;
+        if (fill > srcSize) fill = srcSize;
+        memcpy(stream->tail + stream->tailSize, src, fill);
+        stream->tailSize += fill;
+        src += fill;
+        srcSize -= fill;
+        if (stream->tailSize < groupSize) return;
+        HIST_streamAccumulate(stream, stream->tail, groupSize);
+        stream->tailSize = 0;
+    }
+
+    size_t remainder = srcSize % groupSize;
+    HIST_streamAccumulate(stream, src, srcSize - remainder);
+
+    memcpy(stream->tail, src + srcSize - remainder, remainder);
+    stream->tailSize = remainder;
+}
+
+int HIST_streamFinalize(const HIST_stream_t *stream, U32 *count)
+{
+    for (int i = 0; i < 256; i++) count[i] = (U32)stream->total[i];
+    HIST_reduce((U32 (*)[COUNT_SIZE])stream->table, 16, count, 1);
+    for (size_t i = 0; i < stream->tailSize; i++) {
+        count[stream->tail[i]]++;
+    }
+
+    return count[0];
+}
+
+U64 HIST_streamFinalize64(const HIST_stream_t *stream, U64 *count)
+{
+    memcpy(count, stream->total, sizeof(stream->total));
+    HIST_reduce64((U32 (*)[COUNT_SIZE])stream->table, 16, count);
+    for (size_t i = 0; i < stream->tailSize; i++) {
+        count[stream->tail[i]]++;
+    }
+
+    return count[0];
+}
+
+
+// Lazy reduction: the caller keeps the sub-tables and reduces once, so
+// many blocks (or many threads' table sets) cost one reduction in total.
+
+void HIST_tablesInit(HIST_tables_t *tables)
+{
+    memset(tables, 0, sizeof(*tables));
+}
+
+void HIST_countTables(HIST_tables_t *tables, const uint8_t *src, size_t srcSize)
+{
+    size_t bulk = srcSize - srcSize % 16;
+    count2x64_accumulate(src, bulk, tables->table);
+    for (size_t i = bulk; i < srcSize; i++) tables->table[0][src[i]]++;
+}
+
+int HIST_reduceTables(const HIST_tables_t *tables, size_t nbTables, U32 *count)
+{
+    memset(count, 0, HIST_SYMBOLS * sizeof(*count));
+    for (size_t t = 0; t < nbTables; t++)
+        HIST_reduce((U32 (*)[COUNT_SIZE])tables[t].table, 16, count, 1);
+    return count[0];
+}
+
+
+// 64-bit totals: the 32-bit sub-tables are only safe while no bin can
+// pass 2^32, so long inputs are cut into slices of HIST_FLUSH_SIZE bytes
+// and each slice's result is widened into the 64-bit totals.  Inputs
+// shorter than one slice pay for a single widening pass and nothing else.
+
+U64 HIST_count64(HIST_kernel_t kernel, const uint8_t *src, size_t srcSize, U64 *count)
+{
+    U32 slice[HIST_SYMBOLS] __attribute__((aligned(32)));
+
+    memset(count, 0, HIST_SYMBOLS * sizeof(*count));
+    do {
+        size_t sliceSize = srcSize < HIST_FLUSH_SIZE ? srcSize : HIST_FLUSH_SIZE;
+        kernel(src, sliceSize, slice);
+        HIST_widenCounts(count, slice);
+        src += sliceSize;
+        srcSize -= sliceSize;
+    } while (srcSize);
+
+    return count[0];
+}
+
+
+// Parallel driver: each worker histograms one contiguous chunk into its
+// own table (the kernels' sub-tables are already per thread) and the
+// tables are summed with SIMD once every worker has finished.
+
+#define HIST_MAX_THREADS 256
+#define HIST_CHUNK_ALIGN 64  // keep chunk starts on cache line boundaries
+
+// Memory placement.  On NUMA machines, HIST_bindWorkers(1) runs worker t
+// of nbThreads on node t * nbNodes / nbThreads, and HIST_firstTouch()
+// faults each chunk of a buffer in from that same node, so every worker
+// counts local memory.  Node CPU lists come from sysfs, read once.
+#define HIST_MAX_NODES 64
+#define HIST_HUGEPAGE ((size_t)2 << 20)
+#define HIST_MPOL_BIND 2  // <numaif.h>, without needing libnuma
+
+static int g_nbNodes;
+static cpu_set_t g_nodeCpus[HIST_MAX_NODES];
+static int g_bindWorkers;
+static pthread_once_t g_nodesOnce = PTHREAD_ONCE_INIT;
+
+// "0-3,8-11" style list, as in sysfs
+static void HIST_parseCpuList(const char *list, cpu_set_t *cpus)
+{
+    CPU_ZERO(cpus);
+    while (*list) {
+        char *end;
+        long first = strtol(list, &end, 10), last = first;
+        if (end == list) break;
+        if (*end == '-') last = strtol(end + 1, &end, 10);
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) CPU_SET(cpu, cpus);
+        list = end + (*end == ',');
+    }
+}
+
+static void HIST_initNodes(void)
+{
+    char path[64], line[1024];
+
+    g_nbNodes = 0;
+    for (int node = 0; node < HIST_MAX_NODES; node++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *f = fopen(path, "r");
+        if (!f) break;
+        if (fgets(line, sizeof(line), f)) HIST_parseCpuList(line, &g_nodeCpus[node]);
+        fclose(f);
+        g_nbNodes = node + 1;
+    }
+    if (!g_nbNodes) g_nbNodes = 1;  // no sysfs: one node, no binding
+}
+
+int HIST_numaNodes(void)
+{
+    pthread_once(&g_nodesOnce, HIST_initNodes);
+    return g_nbNodes;
+}
+
+void HIST_bindWorkers(int enable)
+{
+    g_bindWorkers = enable && HIST_numaNodes() > 1;
+}
+
+// Node of worker t, or -1 when workers are not bound
+static int HIST_workerNode(unsigned t, unsigned nbThreads)
+{
+    return g_bindWorkers ? (int)(t * g_nbNodes / nbThreads) : -1;
+}
+
+void *HIST_alloc(size_t size, unsigned flags, int node)
+{
+    size_t mapSize = size ? (size + HIST_HUGEPAGE - 1) & ~(HIST_HUGEPAGE - 1) : HIST_HUGEPAGE;
+    uint8_t *buffer = MAP_FAILED;
+
+    if (flags & HIST_ALLOC_HUGETLB)
+        buffer = mmap(NULL, mapSize, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (buffer == MAP_FAILED) {
+        // map 2 MB more and keep the aligned part, so every page can be huge
+        uint8_t *region = mmap(NULL, mapSize + HIST_HUGEPAGE, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) return NULL;
+        buffer = (uint8_t *)(((uintptr_t)region + HIST_HUGEPAGE - 1) & ~(uintptr_t)(HIST_HUGEPAGE - 1));
+        if (buffer > region) munmap(region, buffer - region);
+        munmap(buffer + mapSize, region + HIST_HUGEPAGE - buffer);
+        madvise(buffer, mapSize, MADV_HUGEPAGE);
+    }
+    if (node >= 0 && node < HIST_MAX_NODES && HIST_numaNodes() > 1) {
+        unsigned long nodeMask = 1UL << node;
+        syscall(SYS_mbind, buffer, mapSize, HIST_MPOL_BIND, &nodeMask, sizeof(nodeMask) * 8, 0);
+    }
+    return buffer;
+}
+
+void HIST_free(void *buffer, size_t size)
+{
+    size_t mapSize = size ? (size + HIST_HUGEPAGE - 1) & ~(HIST_HUGEPAGE - 1) : HIST_HUGEPAGE;
+    if (buffer) munmap(buffer, mapSize);
+}
+
+// Split srcSize into nbThreads cache line aligned chunks; the last one
+// takes the remainder.  0 if the buffer is too small to split.
+static size_t HIST_chunkSize(size_t srcSize, unsigned nbThreads)
+{
+    size_t chunkSize = srcSize / (nbThreads ? nbThreads : 1);
+    return chunkSize & ~(size_t)(HIST_CHUNK_ALIGN - 1);
+}
+
+typedef struct {
+    uint8_t *start;
+    size_t size;
+} HIST_touch_t;
+
+static void *HIST_touchMain(void *arg)
+{
+    HIST_touch_t *touch = arg;
+    memset(touch->start, 0, touch->size);
+    return NULL;
+}
+
+// Start fn(arg) on a thread that runs on node (any CPU if node < 0).
+// Returns 0 if the thread could not be created.
+static int HIST_startOnNode(pthread_t *thread, int node, void *(*fn)(void *), void *arg)
+{
+    pthread_attr_t attr;
+    int started;
+
+    pthread_attr_init(&attr);
+    if (node >= 0) pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &g_nodeCpus[node]);
+    started = !pthread_create(thread, &attr, fn, arg);
+    pthread_attr_destroy(&attr);
+    return started;
+}
+
+void HIST_firstTouch(void *buffer, size_t size, unsigned nbThreads)
+{
+    HIST_touch_t touch[HIST_MAX_THREADS];
+    pthread_t threads[HIST_MAX_THREADS];
+    int started[HIST_MAX_THREADS];
+
+    if (nbThreads > HIST_MAX_THREADS) nbThreads = HIST_MAX_THREADS;
+    size_t chunkSize = HIST_chunkSize(size, nbThreads);
+    if (nbThreads <= 1 || !chunkSize) { memset(buffer, 0, size); return; }
+
+    for (unsigned t = 0; t < nbThreads; t++) {
+        touch[t].start = (uint8_t *)buffer + t * chunkSize;
+        touch[t].size = t == nbThreads - 1 ? size - t * chunkSize : chunkSize;
+        started[t] = HIST_startOnNode(&threads[t], HIST_workerNode(t, nbThreads), HIST_touchMain, &touch[t]);
+        if (!started[t]) HIST_touchMain(&touch[t]);
+    }
+    for (unsigned t = 0; t < nbThreads; t++)
+        if (started[t]) pthread_join(threads[t], NULL);
+}
+
+typedef struct {
+    HIST_kernel_t kernel;
+    const uint8_t *src;
+    size_t srcSize;
+    pthread_t thread;
+    int started;
+    int wide;    // 64-bit totals in count64 rather than count
+    U32 count[HIST_SYMBOLS] __attribute__((aligned(64)));
+    U64 count64[HIST_SYMBOLS] __attribute__((aligned(64)));
+} HIST_worker_t;
+
+static void *HIST_workerMain(void *arg)
+{
+    HIST_worker_t *worker = arg;
+    if (worker->wide) HIST_count64(worker->kernel, worker->src, worker->srcSize, worker->count64);
+    else worker->kernel(worker->src, worker->srcSize, worker->count);
+    return NULL;
+}
+
+// sum += add, for HIST_SYMBOLS counters
+__attribute__((target("avx2")))
+static void HIST_mergeCountsAVX2(U32 *sum, const U32 *add)
+{
+    for (int i = 0; i < HIST_SYMBOLS; i += 8) {
+        __m256i vec = _mm256_loadu_si256((const __m256i *)&sum[i]);
+        vec = _mm256_add_epi32(vec, _mm256_load_si256((const __m256i *)&add[i]));
+        _mm256_storeu_si256((__m256i *)&sum[i], vec);
+    }
+}
+
+static void HIST_mergeCountsSSE2(U32 *sum, const U32 *add)
+{
+    for (int i = 0; i < HIST_SYMBOLS; i += 4) {
+        __m128i vec = _mm_loadu_si128((const __m128i *)&sum[i]);
+        vec = _mm_add_epi32(vec, _mm_load_si128((const __m128i *)&add[i]));
+        _mm_storeu_si128((__m128i *)&sum[i], vec);
+    }
+}
+
+static void HIST_mergeCounts(U32 *sum, const U32 *add)
+{
+    if (__builtin_cpu_supports("avx2")) HIST_mergeCountsAVX2(sum, add);
+    else HIST_mergeCountsSSE2(sum, add);
+}
+
+// sum += add, for HIST_SYMBOLS 64-bit counters
+__attribute__((target("avx2")))
+static void HIST_mergeCounts64AVX2(U64 *sum, const U64 *add)
+{
+    for (int i = 0; i < HIST_SYMBOLS; i += 4) {
+        __m256i vec = _mm256_loadu_si256((const __m256i *)&sum[i]);
+        vec = _mm256_add_epi64(vec, _mm256_load_si256((const __m256i *)&add[i]));
+        _mm256_storeu_si256((__m256i *)&sum[i], vec);
+    }
+}
+
+static void HIST_mergeCounts64SSE2(U64 *sum, const U64 *add)
+{
+    for (int i = 0; i < HIST_SYMBOLS; i += 2) {
+        __m128i vec = _mm_loadu_si128((const __m128i *)&sum[i]);
+        vec = _mm_add_epi64(vec, _mm_load_si128((const __m128i *)&add[i]));
+        _mm_storeu_si128((__m128i *)&sum[i], vec);
+    }
+}
+
+static void HIST_mergeCounts64(U64 *sum, const U64 *add)
+{
+    if (__builtin_cpu_supports("avx2")) HIST_mergeCounts64AVX2(sum, add);
+    else HIST_mergeCounts64SSE2(sum, add);
+}
+
+// Exactly one of count and count64 is non-NULL and receives the result.
+static void HIST_runParallel(HIST_kernel_t kernel, const uint8_t *src, size_t srcSize,
+                             U32 *count, U64 *count64, unsigned nbThreads)
+{
+    HIST_worker_t *workers = NULL;
+
+    if (nbThreads > HIST_MAX_THREADS) nbThreads = HIST_MAX_THREADS;
+    size_t chunkSize = HIST_chunkSize(srcSize, nbThreads);
+    if (nbThreads > 1 && chunkSize > 0) {
+        workers = memalign(64, nbThreads * sizeof(*workers));
+    }
+    if (!workers) {
+        if (count64) HIST_count64(kernel, src, srcSize, count64);
+        else kernel(src, srcSize, count);
+        return;
+    }
+
+    for (unsigned t = 0; t < nbThreads; t++) {
+        workers[t].kernel = kernel;
+        workers[t].src = src + t * chunkSize;
+        workers[t].srcSize = chunkSize;
+        workers[t].wide = (count64 != NULL);
+    }
+    workers[nbThreads - 1].srcSize = srcSize - (nbThreads - 1) * chunkSize;
+
+    // calling thread takes chunk 0; fall back to doing a chunk inline
+    // if the system refuses to give us another thread
+    for (unsigned t = 1; t < nbThreads; t++) {
+        workers[t].started = HIST_startOnNode(&workers[t].thread, HIST_workerNode(t, nbThreads),
+                                              HIST_workerMain, &workers[t]);
+        if (!workers[t].started) HIST_workerMain(&workers[t]);
+    }
+    // the caller is worker 0: move it to node 0 for its chunk only
+    cpu_set_t callerCpus;
+    int moved = HIST_workerNode(0, nbThreads) == 0
+                && !sched_getaffinity(0, sizeof(callerCpus), &callerCpus)
+                && !sched_setaffinity(0, sizeof(cpu_set_t), &g_nodeCpus[0]);
+    HIST_workerMain(&workers[0]);
+    if (moved) sched_setaffinity(0, sizeof(callerCpus), &callerCpus);
+
+    if (count64) memcpy(count64, workers[0].count64, sizeof(workers[0].count64));
+    else memcpy(count, workers[0].count, sizeof(workers[0].count));
+    for (unsigned t = 1; t < nbThreads; t++) {
+        if (workers[t].started) pthread_join(workers[t].thread, NULL);
+        if (count64) HIST_mergeCounts64(count64, workers[t].count64);
+        else HIST_mergeCounts(count, workers[t].count);
+    }
+
+    free(workers);
+}
+
+int HIST_countParallel(HIST_kernel_t kernel, const uint8_t *src, size_t srcSize,
+                       U32 *count, unsigned nbThreads)
+{
+    HIST_runParallel(kernel, src, srcSize, count, NULL, nbThreads);
+    return count[0];
+}
+
+U64 HIST_countParallel64(HIST_kernel_t kernel, const uint8_t *src, size_t srcSize,
+                         U64 *count, unsigned nbThreads)
+{
+    HIST_runParallel(kernel, src, srcSize, NULL, count, nbThreads);
+    return count[0];
+}
+
+
+// 16-bit symbols (match lengths, offsets, samples).  Tables of 2^symbolBits
+// counters are too big for TLS at 16 bits (256 KB each), so the sub-tables
+// live in per-thread scratch that is kept between calls and freed when the
+// thread exits.  Each sub-table is padded like COUNT_SIZE.
+
+static __thread void *t_scratch;
+static __thread size_t t_scratchSize;
+static pthread_key_t g_scratchKey;
+static pthread_once_t g_scratchOnce = PTHREAD_ONCE_INIT;
+
+static void HIST_initScratch(void)
+{
+    pthread_key_create(&g_scratchKey, free);
+}
+
+static void *HIST_scratch(size_t size)
+{
+    if (size > t_scratchSize) {
+        void *scratch;
+        pthread_once(&g_scratchOnce, HIST_initScratch);
+        free(t_scratch);
+        t_scratch = NULL;
+        t_scratchSize = 0;
+        pthread_setspecific(g_scratchKey, NULL);  // or the destructor frees it again
+        if (posix_memalign(&scratch, 64, size)) return NULL;
+        t_scratch = scratch;
+        t_scratchSize = size;
+        pthread_setspecific(g_scratchKey, t_scratch);
+    }
+    return t_scratch;
+}
+
+#define SYM16_PAD 16
+#define SYM16_GROUPS 65535  // U16 sub-counters gain at most one per group
+
+// 4 symbols per 64-bit load, masked to symbolBits
+#define SYM16_INC_WORD(table0, table1, table2, table3, word, mask)     \
+    do {                                                                \
+        table0[(word)         & (mask)]++;                              \
+        table1[((word) >> 16) & (mask)]++;                              \
+        table2[((word) >> 32) & (mask)]++;                              \
+        table3[((word) >> 48) & (mask)]++;                              \
+    } while (0)
+
+// One table: the caller's count[] itself.  Smallest footprint (L1 up to
+// 12 bits, L2 at 16), but repeated symbols serialise on store forwarding.
+HIST_BODY int count16_1x32_body(const uint16_t *src, size_t nbSymbols, U32 *count, unsigned symbolBits)
+{
+    const U64 mask = ((U64)1 << symbolBits) - 1;
+    size_t i = 0;
+
+    memset(count, 0, ((size_t)1 << symbolBits) * sizeof(*count));
+    for (; i + 4 <= nbSymbols; i += 4) {
+        U64 word = *(const U64 *)(src + i);
+        SYM16_INC_WORD(count, count, count, count, word, mask);
+    }
+    for (; i < nbSymbols; i++) count[src[i] & mask]++;
+
+    return count[0];
+}
+
+// Reductions of the four sub-tables (stride apart) into count[], 8 or 4
+// bins per step, with a scalar tail for narrow symbol widths.  Called once
+// per call (per SYM16_GROUPS groups for the U16 tables), so they dispatch
+// at run time like HIST_reduce rather than follow the kernel's target.
+__attribute__((target("avx2")))
+static void HIST_sum16x32AVX2(U32 *count, const U32 *t0, size_t stride, size_t nbBins)
+{
+    size_t b = 0;
+    for (; b + 8 <= nbBins; b += 8) {
+        __m256i sum = _mm256_loadu_si256((const __m256i *)(t0 + b));
+        sum = _mm256_add_epi32(sum, _mm256_loadu_si256((const __m256i *)(t0 + stride + b)));
+        sum = _mm256_add_epi32(sum, _mm256_loadu_si256((const __m256i *)(t0 + 2*stride + b)));
+        sum = _mm256_add_epi32(sum, _mm256_loadu_si256((const __m256i *)(t0 + 3*stride + b)));
+        _mm256_storeu_si256((__m256i *)(count + b), sum);
+    }
+    for (; b < nbBins; b++) count[b] = t0[b] + t0[stride + b] + t0[2*stride + b] + t0[3*stride + b];
+}
+
+static void HIST_sum16x32SSE2(U32 *count, const U32 *t0, size_t stride, size_t nbBins)
+{
+    size_t b = 0;
+    for (; b + 4 <= nbBins; b += 4) {
+        __m128i sum = _mm_loadu_si128((const __m128i *)(t0 + b));
+        sum = _mm_add_epi32(sum, _mm_loadu_si128((const __m128i *)(t0 + stride + b)));
+        sum = _mm_add_epi32(sum, _mm_loadu_si128((const __m128i *)(t0 + 2*stride + b)));
+        sum = _mm_add_epi32(sum, _mm_loadu_si128((const __m128i *)(t0 + 3*stride + b)));
+        _mm_storeu_si128((__m128i *)(count + b), sum);
+    }
+    for (; b < nbBins; b++) count[b] = t0[b] + t0[stride + b] + t0[2*stride + b] + t0[3*stride + b];
+}
+
+// count[b] = t0[b] + t1[b] + t2[b] + t3[b]
+static void HIST_sum16x32(U32 *count, const U32 *t0, size_t stride, size_t nbBins)
+{
+    if (__builtin_cpu_supports("avx2")) HIST_sum16x32AVX2(count, t0, stride, nbBins);
+    else HIST_sum16x32SSE2(count, t0, stride, nbBins);
+}
+
+// U16 tables: each is widened to U32 before the add, since four of them
+// can pass 65535
+__attribute__((target("avx2")))
+static void HIST_add16x16AVX2(U32 *count, const U16 *t0, size_t stride, size_t nbBins)
+{
+    size_t b = 0;
+    for (; b + 8 <= nbBins; b += 8) {
+        __m256i sum = _mm256_loadu_si256((const __m256i *)(count + b));
+        for (int t = 0; t < 4; t++)
+            sum = _mm256_add_epi32(sum, _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(t0 + t*stride + b))));
+        _mm256_storeu_si256((__m256i *)(count + b), sum);
+    }
+    for (; b < nbBins; b++) count[b] += (U32)t0[b] + t0[stride + b] + t0[2*stride + b] + t0[3*stride + b];
+}
+
+static void HIST_add16x16SSE2(U32 *count, const U16 *t0, size_t stride, size_t nbBins)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t b = 0;
+    for (; b + 8 <= nbBins; b += 8) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)(count + b));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(count + b + 4));
+        for (int t = 0; t < 4; t++) {
+            __m128i sub = _mm_loadu_si128((const __m128i *)(t0 + t*stride + b));
+            lo = _mm_add_epi32(lo, _mm_unpacklo_epi16(sub, zero));
+            hi = _mm_add_epi32(hi, _mm_unpackhi_epi16(sub, zero));
+        }
+        _mm_storeu_si128((__m128i *)(count + b), lo);
+        _mm_storeu_si128((__m128i *)(count + b + 4), hi);
+    }
+    for (; b < nbBins; b++) count[b] += (U32)t0[b] + t0[stride + b] + t0[2*stride + b] + t0[3*stride + b];
+}
+
+// count[b] += t0[b] + t1[b] + t2[b] + t3[b]
+static void HIST_add16x16(U32 *count, const U16 *t0, size_t stride, size_t nbBins)
+{
+    if (__builtin_cpu_supports("avx2")) HIST_add16x16AVX2(count, t0, stride, nbBins);
+    else HIST_add16x16SSE2(count, t0, stride, nbBins);
+}
+
+// Four U32 sub-tables, one per position within each 4-symbol group:
+// 4x the footprint (1 MB at 16 bits, so L2/L3), but repeats hit
+// different tables.
+HIST_BODY int count16_4x32_body(const uint16_t *src, size_t nbSymbols, U32 *count, unsigned symbolBits)
+{
+    const size_t nbBins = (size_t)1 << symbolBits;
+    const size_t stride = nbBins + SYM16_PAD;
+    const U64 mask = nbBins - 1;
+    U32 *t0 = HIST_scratch(4 * stride * sizeof(U32));
+    size_t i = 0;
+
+    if (!t0) return -1;
+    U32 *t1 = t0 + stride, *t2 = t1 + stride, *t3 = t2 + stride;
+    memset(t0, 0, 4 * stride * sizeof(U32));
+
+    for (; i + 4 <= nbSymbols; i += 4) {
+        U64 word = *(const U64 *)(src + i);
+        SYM16_INC_WORD(t0, t1, t2, t3, word, mask);
+    }
+    for (; i < nbSymbols; i++) t0[src[i] & mask]++;
+
+    HIST_sum16x32(count, t0, stride, nbBins);
+
+    return count[0];
+}
+
+// Four U16 sub-tables: the footprint of two U32 tables (512 KB at 16 bits,
+// 32 KB at 12), widened into count[] every SYM16_GROUPS groups.
+HIST_BODY int count16_4x16_body(const uint16_t *src, size_t nbSymbols, U32 *count, unsigned symbolBits)
+{
+    const size_t nbBins = (size_t)1 << symbolBits;
+    const size_t stride = nbBins + SYM16_PAD;
+    const U64 mask = nbBins - 1;
+    U16 *t0 = HIST_scratch(4 * stride * sizeof(U16));
+    size_t nbGroups = nbSymbols / 4;
+    size_t i = 0;
+
+    if (!t0) return -1;
+    U16 *t1 = t0 + stride, *t2 = t1 + stride, *t3 = t2 + stride;
+    memset(t0, 0, 4 * stride * sizeof(U16));
+    memset(count, 0, nbBins * sizeof(*count));
+
+    while (nbGroups) {
+        size_t n = nbGroups < SYM16_GROUPS ? nbGroups : SYM16_GROUPS;
+        nbGroups -= n;
+        for (; n; n--, i += 4) {
+            U64 word = *(const U64 *)(src + i);
+            SYM16_INC_WORD(t0, t1, t2, t3, word, mask);
+        }
+        HIST_add16x16(count, t0, stride, nbBins);
+        if (nbGroups) memset(t0, 0, 4 * stride * sizeof(U16));
+    }
+    for (; i < nbSymbols; i++) count[src[i] & mask]++;
+
+    return count[0];
+}
+
+#define HIST_VARIANT16(name, suffix, isa)                               \
+    __attribute__((target(isa)))                                        \
+    int name##suffix(const uint16_t *src, size_t nbSymbols, U32 *count, unsigned symbolBits) \
+    { return name##_body(src, nbSymbols, count, symbolBits); }
+
+HIST_VARIANT16(count16_1x32, , "sse2")
+HIST_VARIANT16(count16_4x32, , "sse2")
+HIST_VARIANT16(count16_4x16, , "sse2")
+static HIST_VARIANT16(count16_1x32, _avx2, "avx2,bmi2")
+static HIST_VARIANT16(count16_4x32, _avx2, "avx2,bmi2")
+static HIST_VARIANT16(count16_4x16, _avx2, "avx2,bmi2")
+
+typedef struct {
+    HIST_kernel16_t generic;
+    HIST_kernel16_t avx2;
+} HIST_variant16_t;
+
+static const HIST_variant16_t g_variants16[] = {
+    { count16_1x32, count16_1x32_avx2 },
+    { count16_4x32, count16_4x32_avx2 },
+    { count16_4x16, count16_4x16_avx2 },
+};
+
+HIST_kernel16_t HIST_bestVariant16(HIST_kernel16_t kernel)
+{
+    for (size_t v = 0; v < sizeof(g_variants16) / sizeof(*g_variants16); v++) {
+        if (g_variants16[v].generic == kernel)
+            return HIST_isaSupported(HIST_ISA_AVX2) ? g_variants16[v].avx2 : kernel;
+    }
+    return kernel;
+}
+
+int HIST_count16(const uint16_t *src, size_t nbSymbols, U32 *count, unsigned symbolBits)
+{
+    if (symbolBits > HIST_MAX_SYMBOL_BITS) symbolBits = HIST_MAX_SYMBOL_BITS;
+    return HIST_bestVariant16(count16_4x16)(src, nbSymbols, count, symbolBits);
+}
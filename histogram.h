@@ -0,0 +1,208 @@
+/*
+  histogram.h - byte histogram kernels from countbench, as a library
+  Copyright (C) Yann Collet 2012-2014  GPL v2 License
+
+  Build the library with the lines at the top of histogram.c and link
+  libhistogram.a or libhistogram.so; countbench.c is just one caller of
+  this interface.
+*/
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stddef.h>    // size_t
+#include <stdint.h>    // uintX_t types
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#define HIST_SYMBOLS 256
+
+// Sub-tables are overallocated to avoid 4K aliasing of the same byte
+// within different tables (helps avoid CPU misspeculation)
+#define HIST_COUNT_SIZE (HIST_SYMBOLS + 8)
+
+// Common signature of every kernel: count[HIST_SYMBOLS] is owned by the
+// caller and receives the full histogram of src[0..srcSize).  The return
+// value is count[0], which the benchmark prints as a cheap checksum.
+// Kernels are reentrant: sub-histograms are kept per thread, so any number
+// of threads may call them at once without locking.
+typedef int (*HIST_kernel_t)(const uint8_t *src, size_t srcSize, uint32_t *count);
+
+// Histogram with the best kernel variant this CPU supports (for this
+// block size, if a tuning file has been loaded; see HIST_loadTuning())
+int HIST_count(const uint8_t *src, size_t srcSize, uint32_t *count);
+
+// Same, with a hint that every byte of src is <= maxSymbol (entropy coders
+// often know their alphabet is small).  Small alphabets are counted with
+// in-register vertical counters; a wrong hint costs a recount, not a
+// wrong histogram.
+int HIST_countHint(const uint8_t *src, size_t srcSize, uint32_t *count, unsigned maxSymbol);
+
+// Restricted alphabet, for FSE/Huffman front-ends: count[] has
+// *maxSymbolValuePtr + 1 bins, and only that many are cleared and reduced.
+// Returns the largest bin and sets *maxSymbolValuePtr to the largest byte
+// present, or returns HIST_ERROR if src holds a byte above the bound.
+#define HIST_ERROR ((size_t)-1)
+size_t HIST_countLimited(const uint8_t *src, size_t srcSize, uint32_t *count,
+                         unsigned *maxSymbolValuePtr);
+
+// Batches: histogram many independent buffers (literals, lengths and
+// offsets of one block, or many small blocks) in one interleaved pass,
+// each into its own count[HIST_SYMBOLS].  Returns jobs[0].count[0].
+typedef struct {
+    const uint8_t *src;
+    size_t srcSize;
+    uint32_t *count;
+} HIST_job_t;
+
+int HIST_countBatch(const HIST_job_t *jobs, size_t nbJobs);
+
+// Runtime dispatch.  Each kernel family is compiled for one or more
+// instruction sets; the variant table lists them best first, and
+// HIST_count() uses the first entry the CPU supports (probed once with
+// cpuid at startup).  The plain kernel names below are the baseline
+// variants and only run on CPUs with their instruction set.
+typedef enum {
+    HIST_ISA_GENERIC,  // x86-64 baseline (SSE2)
+    HIST_ISA_SSE41,
+    HIST_ISA_AVX,
+    HIST_ISA_AVX2,     // with BMI, BMI2 and POPCNT (count_runs needs all three)
+    HIST_ISA_AVX512,   // AVX-512F
+} HIST_isa_t;
+
+typedef struct {
+    const char *name;      // kernel family, e.g. "hist_8_64"
+    HIST_isa_t isa;        // instruction set this variant was compiled for
+    HIST_kernel_t kernel;
+} HIST_variant_t;
+
+const HIST_variant_t *HIST_variants(size_t *nbVariants);
+const HIST_variant_t *HIST_selected(void);  // variant used by HIST_count()
+const char *HIST_isaName(HIST_isa_t isa);
+int HIST_isaSupported(HIST_isa_t isa);
+const HIST_variant_t *HIST_findVariant(const char *name, const char *isaName);
+// Best supported variant of kernel's family: kernel itself if it is not
+// a library kernel, NULL if the CPU supports none of the family.
+HIST_kernel_t HIST_bestVariant(HIST_kernel_t kernel);
+
+// Tuning.  countbench --autotune measures every variant on this host and
+// writes block size thresholds ("maxBlockSize kernel isa" per line, in
+// any order) to a file.  The file named by $HIST_TUNING is loaded at startup; programs may
+// also load one explicitly, before any thread calls HIST_count().
+// Returns the number of usable thresholds, or -1 if the file can't be read.
+int HIST_loadTuning(const char *path);
+const HIST_variant_t *HIST_tunedVariant(size_t srcSize);  // what HIST_count() uses
+
+// Split src into nbThreads contiguous chunks, histogram each chunk with
+// kernel on its own thread, and merge the per-thread results into count.
+// nbThreads <= 1 (or a buffer too small to split) just calls kernel.
+int HIST_countParallel(HIST_kernel_t kernel, const uint8_t *src, size_t srcSize,
+                       uint32_t *count, unsigned nbThreads);
+
+// Memory for large inputs.  HIST_alloc() maps size bytes aligned to 2 MB,
+// from the explicit huge page pool with HIST_ALLOC_HUGETLB (if the pool
+// has room) or else advised for transparent huge pages, so big buffers are
+// not counted through 4K TLB misses.  node >= 0 binds the pages to that
+// NUMA node; HIST_NODE_ANY leaves placement to first touch.  Release with
+// HIST_free() and the same size.
+#define HIST_ALLOC_HUGETLB 1
+#define HIST_NODE_ANY (-1)
+void *HIST_alloc(size_t size, unsigned flags, int node);
+void HIST_free(void *buffer, size_t size);
+int HIST_numaNodes(void);
+// NUMA-local parallel counting: with binding on, HIST_countParallel() runs
+// worker t of nbThreads on node t * nodes / nbThreads, and HIST_firstTouch()
+// zeroes a fresh buffer in the same chunks from the same nodes, so each
+// chunk's pages are local to the worker that counts it.  Binding is a
+// no-op on single node machines; first touch then just zeroes the buffer.
+void HIST_bindWorkers(int enable);
+void HIST_firstTouch(void *buffer, size_t size, unsigned nbThreads);
+
+// 64-bit totals, for inputs where a single bin could pass 2^32.  The
+// kernel runs on slices of at most HIST_FLUSH_SIZE bytes, so its 32-bit
+// sub-tables cannot wrap, and each slice is widened into count[].
+// Both return count[0].
+#define HIST_FLUSH_SIZE ((size_t)1 << 31)
+uint64_t HIST_count64(HIST_kernel_t kernel, const uint8_t *src, size_t srcSize,
+                      uint64_t *count);
+uint64_t HIST_countParallel64(HIST_kernel_t kernel, const uint8_t *src, size_t srcSize,
+                              uint64_t *count, unsigned nbThreads);
+
+// Streaming: for data that arrives in many small pieces.  The padded
+// sub-tables stay live between updates, partial 16-byte groups are carried
+// over to the next update, and the tables are only reduced on finalize,
+// so many small updates cost about the same as one large buffer.
+// Finalize does not modify the stream: more updates may follow it.
+// The struct is public so it can live on the stack; treat it as opaque.
+typedef struct {
+    uint32_t table[16][HIST_COUNT_SIZE];
+    uint64_t total[HIST_SYMBOLS];  // flushed every HIST_FLUSH_SIZE bytes
+    size_t sinceFlush;
+    size_t tailSize;
+    uint8_t tail[16];
+} __attribute__((aligned(64))) HIST_stream_t;
+
+void HIST_streamInit(HIST_stream_t *stream);
+void HIST_streamUpdate(HIST_stream_t *stream, const uint8_t *src, size_t srcSize);
+int HIST_streamFinalize(const HIST_stream_t *stream, uint32_t *count);
+uint64_t HIST_streamFinalize64(const HIST_stream_t *stream, uint64_t *count);
+
+// 16-bit symbols: count[] has 2^symbolBits bins (up to 65536) and only the
+// low symbolBits bits of each symbol are counted.  Kernels are named after
+// their sub-tables (count16_4x16: four tables of U16 counters); larger
+// tables break store forwarding chains at the cost of L1 and L2 space.
+// They return count[0], or -1 if scratch tables could not be allocated.
+#define HIST_MAX_SYMBOL_BITS 16
+typedef int (*HIST_kernel16_t)(const uint16_t *src, size_t nbSymbols, uint32_t *count,
+                               unsigned symbolBits);
+
+int HIST_count16(const uint16_t *src, size_t nbSymbols, uint32_t *count, unsigned symbolBits);
+HIST_kernel16_t HIST_bestVariant16(HIST_kernel16_t kernel);  // AVX2 build if the CPU has it
+int count16_1x32(const uint16_t *src, size_t nbSymbols, uint32_t *count, unsigned symbolBits);
+int count16_4x32(const uint16_t *src, size_t nbSymbols, uint32_t *count, unsigned symbolBits);
+int count16_4x16(const uint16_t *src, size_t nbSymbols, uint32_t *count, unsigned symbolBits);
+
+// Lazy reduction: count blocks into a caller-owned set of sub-tables and
+// reduce them in one final pass, instead of once per block.  Successive
+// HIST_countTables() calls accumulate; HIST_reduceTables() sums one or
+// more table sets (say, one per thread) into count[].  Each set holds up
+// to HIST_FLUSH_SIZE bytes between reductions.
+typedef struct {
+    uint32_t table[16][HIST_COUNT_SIZE];
+} __attribute__((aligned(64))) HIST_tables_t;
+
+void HIST_tablesInit(HIST_tables_t *tables);
+void HIST_countTables(HIST_tables_t *tables, const uint8_t *src, size_t srcSize);
+int HIST_reduceTables(const HIST_tables_t *tables, size_t nbTables, uint32_t *count);
+
+// Individual kernels (see histogram.c for what each one is trying).
+// countbench and the dispatch find kernels through HIST_variants(), so a
+// new kernel only needs its line in the variant table; a prototype here is
+// for callers who want to name it directly.
+int trivialCount(const uint8_t *src, size_t srcSize, uint32_t *count);
+int count_vec(const uint8_t *src, size_t srcSize, uint32_t *count);
+int vecavx(const uint8_t *src, size_t srcSize, uint32_t *count);
+int storePort7(const uint8_t *src, size_t srcSize, uint32_t *count);
+int reloadPort7(const uint8_t *src, size_t srcSize, uint32_t *count);
+int count8reload(const uint8_t *src, size_t srcSize, uint32_t *count);
+int count2x64(const uint8_t *src, size_t srcSize, uint32_t *count);
+int hist_4_32(const uint8_t *in, size_t inlen, uint32_t *count);
+int hist_4_64(const uint8_t *in, size_t inlen, uint32_t *count);
+int hist_8_64(const uint8_t *in, size_t inlen, uint32_t *count);
+int hist_4_128(const uint8_t *in, size_t inlen, uint32_t *count);
+int hist_8_128(const uint8_t *in, size_t inlen, uint32_t *count);
+int hist_16_64_u8(const uint8_t *in, size_t inlen, uint32_t *count);
+int hist_16_64_u16(const uint8_t *in, size_t inlen, uint32_t *count);
+int count_runs(const uint8_t *src, size_t srcSize, uint32_t *count);
+// counts only bytes <= maxSymbol
+int count_vertical(const uint8_t *src, size_t srcSize, uint32_t *count, unsigned maxSymbol);
+int port7vec(const uint8_t *src, size_t srcSize, uint32_t *count);
+int scatter512(const uint8_t *src, size_t srcSize, uint32_t *count);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif // HISTOGRAM_H